@@ -45,9 +45,11 @@ int main ()
     // k-means
     scl::KMeans kmeans;
     kmeans.setParameters(max_iter, tolerance, max_pp_trial);
+    kmeans.setNumInit(4);
     if ( kmeans.clustering(dim, dataset, cluster_size, centroids, scl::KMeans::PLUSPLUS) )
     {
         std::cout << "success" << std::endl;
+        std::cout << "inertia : " << kmeans.getResult().inertia << ",  iterations : " << kmeans.getResult().num_iterations << std::endl;
 
         // show cluster data
         std::vector< std::vector<std::size_t> > clusters( kmeans.getClusters() );
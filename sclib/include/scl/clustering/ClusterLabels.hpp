@@ -0,0 +1,361 @@
+/**
+ * @file ClusterLabels.hpp
+ * @brief クラスタリング結果 (各データのクラスタID) の保持
+ */
+
+#ifndef SCL_CLUSTER_LABELS_HPP
+#define SCL_CLUSTER_LABELS_HPP
+
+#include <vector>
+#include <cstdint>    // uint32_t
+#include <cstddef>
+#include <utility>    // swap
+#include <stdexcept>  // out_of_range
+
+namespace scl
+{
+    /**
+     * @class ClusterLabels
+     * @brief 各データのクラスタIDを uint32_t の配列で持つ
+     * @details クラスタごとのデータ (CSR 形式 : offsets + members) と
+     * std::vector< std::vector<std::size_t> > 形式は要求されたときに作る (後者は要求されたクラスタだけ)。 @n
+     * クラスタ c のデータIDは members[offsets[c]] ... members[offsets[c+1]-1] (ラベル配列の順)
+     * @attention 作成済みでない CSR / クラスタリストを複数スレッドから同時に要求しないこと
+     */
+    class ClusterLabels
+    {
+    public:
+        /** @brief コンストラクタ */
+        ClusterLabels();
+
+
+        /**
+         * @brief ラベル配列の初期化
+         * @param[in] num_data データ数
+         * @param[in] num_clusters クラスタ数
+         * @return 書き込み用のラベル配列 (サイズ num_data)
+         * @details 作成済みの CSR / クラスタリストは破棄する。データIDの対応はそのまま
+         */
+        std::vector<std::uint32_t> & resetLabels(const std::size_t num_data, const std::size_t num_clusters);
+
+
+        /**
+         * @brief 書き込み用のラベル配列
+         * @details 作成済みの CSR / クラスタリストは破棄する
+         */
+        std::vector<std::uint32_t> & getMutableLabels();
+
+
+        /**
+         * @brief クラスタリストから設定
+         * @param[in] num_data データ数
+         * @param[in] clusters クラスタごとのデータ (0 ... num_data-1 のインデックス)
+         */
+        void setClusters(const std::size_t num_data, const std::vector< std::vector<std::size_t> > &clusters);
+
+
+        /**
+         * @brief ラベル配列のインデックスとデータIDの対応を設定
+         * @param[in] data_ids i 番目のラベルのデータID (空ならラベル配列のインデックスがそのままデータID)
+         */
+        void setDataIds(const std::vector<std::size_t> &data_ids);
+
+
+        /** @brief 全て破棄 */
+        void clear();
+
+
+        /** @brief 入れ替え */
+        void swap(ClusterLabels &other);
+
+
+        /** @brief 各データのクラスタID */
+        const std::vector<std::uint32_t> & getLabels() const;
+
+
+        /** @brief データIDの対応 (空ならラベル配列のインデックスがデータID) */
+        const std::vector<std::size_t> & getDataIds() const;
+
+
+        /** @brief クラスタ数 */
+        std::size_t getNumClusters() const;
+
+
+        /**
+         * @brief CSR 形式のオフセット (サイズ クラスタ数+1)
+         * @details 最初の呼び出しで CSR を作る。 O(データ数 + クラスタ数)
+         */
+        const std::vector<std::size_t> & getOffsets() const;
+
+
+        /**
+         * @brief CSR 形式のクラスタごとに並べたデータID
+         * @see ClusterLabels::getOffsets
+         */
+        const std::vector<std::size_t> & getMembers() const;
+
+
+        /** @brief 指定したクラスタのデータ数 */
+        std::size_t getClusterSize(const std::size_t cluster_id) const;
+
+
+        /**
+         * @brief 全クラスタの情報取得 (クラスタごとのデータIDの配列)
+         * @details 最初の呼び出しで作る
+         */
+        const std::vector< std::vector<std::size_t> > & getClusters() const;
+
+
+        /**
+         * @brief 指定したクラスタの情報取得
+         * @details 最初の呼び出しで CSR からそのクラスタだけ作る
+         * @exception std::out_of_range cluster_id がクラスタ数以上
+         */
+        const std::vector<std::size_t> & getCluster(const std::size_t cluster_id) const;
+
+
+    private:
+        /** @brief 作成済みの CSR / クラスタリストの破棄 */
+        void discardGroups();
+
+
+        /** @brief CSR の作成 (counting sort) */
+        void buildGroups() const;
+
+
+        /** @brief CSR から1クラスタ分のクラスタリストを作成 */
+        void listCluster(const std::size_t cluster_id) const;
+
+
+        /** @brief 各データのクラスタID */
+        std::vector<std::uint32_t> m_labels;
+
+
+        /** @brief クラスタ数 */
+        std::size_t m_num_clusters;
+
+
+        /** @brief ラベル配列のインデックスに対応するデータID */
+        std::vector<std::size_t> m_data_ids;
+
+
+        /** @brief CSR を作成済みか */
+        mutable bool m_is_grouped;
+
+
+        /** @brief CSR 形式のオフセット */
+        mutable std::vector<std::size_t> m_offsets;
+
+
+        /** @brief CSR 形式のデータID */
+        mutable std::vector<std::size_t> m_members;
+
+
+        /** @brief クラスタリストの領域を確保済みか (各クラスタは ClusterLabels::m_listed_clusters) */
+        mutable bool m_is_listed;
+
+
+        /** @brief クラスタリストを作成済みのクラスタ */
+        mutable std::vector<bool> m_listed_clusters;
+
+
+        /** @brief クラスタリスト */
+        mutable std::vector< std::vector<std::size_t> > m_clusters;
+    };
+
+
+
+
+    //------------------------------------------------------------------
+    // 実装部
+    //------------------------------------------------------------------
+
+    ClusterLabels::ClusterLabels()
+        : m_num_clusters(0),
+          m_is_grouped(false),
+          m_is_listed(false)
+    {
+    }
+
+
+    std::vector<std::uint32_t>& ClusterLabels::resetLabels(const std::size_t num_data, const std::size_t num_clusters)
+    {
+        m_labels.resize(num_data);
+        m_num_clusters = num_clusters;
+        discardGroups();
+        return m_labels;
+    }
+
+
+    std::vector<std::uint32_t>& ClusterLabels::getMutableLabels()
+    {
+        discardGroups();
+        return m_labels;
+    }
+
+
+    void ClusterLabels::setClusters(const std::size_t num_data, const std::vector< std::vector<std::size_t> > &clusters)
+    {
+        std::vector<std::uint32_t> &labels = resetLabels(num_data, clusters.size());
+        for (std::size_t cluster_index = 0; cluster_index < clusters.size(); ++cluster_index)
+        {
+            for (std::size_t member_index = 0; member_index < clusters[cluster_index].size(); ++member_index)
+            {
+                labels[clusters[cluster_index][member_index]] = static_cast<std::uint32_t>(cluster_index);
+            }
+        }
+    }
+
+
+    void ClusterLabels::setDataIds(const std::vector<std::size_t> &data_ids)
+    {
+        m_data_ids = data_ids;
+        discardGroups();
+    }
+
+
+    void ClusterLabels::clear()
+    {
+        m_labels.clear();
+        m_data_ids.clear();
+        m_num_clusters = 0;
+        discardGroups();
+    }
+
+
+    void ClusterLabels::discardGroups()
+    {
+        m_is_grouped = false;
+        m_is_listed = false;
+        m_offsets.clear();
+        m_members.clear();
+        m_listed_clusters.clear();
+        m_clusters.clear();
+    }
+
+
+    void ClusterLabels::swap(ClusterLabels &other)
+    {
+        std::swap(m_num_clusters, other.m_num_clusters);
+        std::swap(m_is_grouped, other.m_is_grouped);
+        std::swap(m_is_listed, other.m_is_listed);
+        m_labels.swap(other.m_labels);
+        m_data_ids.swap(other.m_data_ids);
+        m_offsets.swap(other.m_offsets);
+        m_members.swap(other.m_members);
+        m_listed_clusters.swap(other.m_listed_clusters);
+        m_clusters.swap(other.m_clusters);
+    }
+
+
+    const std::vector<std::uint32_t>& ClusterLabels::getLabels() const
+    {
+        return m_labels;
+    }
+
+
+    const std::vector<std::size_t>& ClusterLabels::getDataIds() const
+    {
+        return m_data_ids;
+    }
+
+
+    std::size_t ClusterLabels::getNumClusters() const
+    {
+        return m_num_clusters;
+    }
+
+
+    const std::vector<std::size_t>& ClusterLabels::getOffsets() const
+    {
+        buildGroups();
+        return m_offsets;
+    }
+
+
+    const std::vector<std::size_t>& ClusterLabels::getMembers() const
+    {
+        buildGroups();
+        return m_members;
+    }
+
+
+    std::size_t ClusterLabels::getClusterSize(const std::size_t cluster_id) const
+    {
+        buildGroups();
+        return m_offsets.at(cluster_id + 1) - m_offsets.at(cluster_id);
+    }
+
+
+    const std::vector< std::vector<std::size_t> >& ClusterLabels::getClusters() const
+    {
+        for (std::size_t cluster_index = 0; cluster_index < m_num_clusters; ++cluster_index)
+        {
+            listCluster(cluster_index);
+        }
+        return m_clusters;
+    }
+
+
+    const std::vector<std::size_t>& ClusterLabels::getCluster(const std::size_t cluster_id) const
+    {
+        if (cluster_id >= m_num_clusters)
+        {
+            throw std::out_of_range("ClusterLabels::getCluster");
+        }
+        listCluster(cluster_id);
+        return m_clusters[cluster_id];
+    }
+
+
+    void ClusterLabels::listCluster(const std::size_t cluster_id) const
+    {
+        if (!m_is_listed)
+        {
+            buildGroups();
+            m_clusters.assign(m_num_clusters, std::vector<std::size_t>());
+            m_listed_clusters.assign(m_num_clusters, false);
+            m_is_listed = true;
+        }
+        if (!m_listed_clusters[cluster_id])
+        {
+            m_clusters[cluster_id].assign(m_members.begin() + m_offsets[cluster_id], m_members.begin() + m_offsets[cluster_id + 1]);
+            m_listed_clusters[cluster_id] = true;
+        }
+    }
+
+
+    void ClusterLabels::buildGroups() const
+    {
+        if (m_is_grouped)
+        {
+            return;
+        }
+
+        // count
+        const std::size_t num_data(m_labels.size());
+        m_offsets.assign(m_num_clusters + 1, 0);
+        for (std::size_t data_index = 0; data_index < num_data; ++data_index)
+        {
+            ++m_offsets[m_labels[data_index] + 1];
+        }
+        for (std::size_t cluster_index = 0; cluster_index < m_num_clusters; ++cluster_index)
+        {
+            m_offsets[cluster_index + 1] += m_offsets[cluster_index];
+        }
+
+        // scatter (クラスタ内はデータ順) //
+        std::vector<std::size_t> positions(m_offsets.begin(), m_offsets.end() - 1);
+        m_members.resize(num_data);
+        for (std::size_t data_index = 0; data_index < num_data; ++data_index)
+        {
+            const std::size_t data_id = m_data_ids.empty() ? data_index : m_data_ids[data_index];
+            m_members[positions[m_labels[data_index]]++] = data_id;
+        }
+        m_is_grouped = true;
+    }
+
+} // end of namespace scl
+
+
+#endif  /* SCL_CLUSTER_LABELS_HPP */
@@ -0,0 +1,487 @@
+/**
+ * @file Coreset.hpp
+ * @brief クラスタリング用の coreset (重み付きの小さな代表点集合) の作成
+ */
+
+#ifndef SCL_CORESET_HPP
+#define SCL_CORESET_HPP
+
+#include <scl/clustering/KMeans.hpp>
+#include <scl/util/Random.hpp>
+#include <scl/util/Parallel.hpp>
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <algorithm>  // sort
+
+namespace scl
+{
+    /**
+     * @class Coreset
+     * @brief k-means 用の coreset を重要度サンプリングで作る
+     * @details 各データを重要度に比例した確率で復元抽出し、重み 1 / (抽出数 x 確率) を付ける。
+     * 結果は KMeans, XMeans, GaussianMixtureModel の重み付きクラスタリングにそのまま使える。 @n
+     * Coreset::add でバッチごとに追加すると merge-and-reduce で逐次的に作れる
+     * (同じ大きさの coreset を2つ合わせて作り直すことを繰り返す。保持する点数は O(coreset_size x log(データ数 / coreset_size))) @n
+     * 論文 @n
+     * <a href="https://arxiv.org/abs/1702.08248">Scalable k-Means Clustering via Lightweight Coresets | O. Bachem, M. Lucic, A. Krause (2018)</a> :
+     * 抽出数 O((dim k log k + log(1/δ)) / ε^2) で、確率 1-δ で評価値の誤差が ε φ(平均) + ε (全体の評価値) 以下 @n
+     * <a href="https://arxiv.org/abs/1703.06476">Practical Coreset Constructions for Machine Learning | O. Bachem, M. Lucic, A. Krause (2017)</a> :
+     * k-means++ の結果から各データの sensitivity の上限を計算して抽出する (評価値の相対誤差 ε)
+     */
+    class Coreset
+    {
+    public:
+        /**
+         * @enum Method
+         * @brief 重要度の計算方法
+         */
+        enum Method
+        {
+            LIGHTWEIGHT,  /**< 全体の平均からの距離 (k-means++ 不要、O(データ数 x dim)) */
+            SENSITIVITY   /**< k-means++ で選んだ重心からの距離とクラスタの大きさ (O(データ数 x k x dim)) */
+        };
+
+
+        /** @brief コンストラクタ */
+        Coreset();
+
+
+        /**
+         * @brief パラメータ設定
+         * @param[in] coreset_size 抽出数
+         * @param[in] method 重要度の計算方法
+         * @param[in] num_clusters Coreset::SENSITIVITY で k-means++ に使うクラスタ数
+         */
+        void setParameters(const std::size_t coreset_size, const Method method=SENSITIVITY, const std::size_t num_clusters=10);
+
+
+        /** @brief 乱数のシードを設定 */
+        void setSeed(const std::uint64_t seed);
+
+
+        /**
+         * @brief coreset の作成
+         * @tparam DataType データの型
+         * @param[in] dim DataTypeの次数
+         * @param[in] dataset データセット
+         * @attention DataType needs [] access operator
+         */
+        template<class DataType>
+        void build(const std::size_t dim, const std::vector<DataType> &dataset);
+
+
+        /**
+         * @brief 重み付きデータからの coreset の作成
+         * @param[in] weights 各データの重み (dataset と同じサイズ、正の値)
+         * @see Coreset::build
+         */
+        template<class DataType>
+        void build(const std::size_t dim, const std::vector<DataType> &dataset, const std::vector<double> &weights);
+
+
+        /**
+         * @brief バッチを追加 (merge-and-reduce)
+         * @details 追加したバッチは捨ててよい。結果は Coreset::getPoints, Coreset::getWeights で取得する
+         * @param[in] dim DataTypeの次数
+         * @param[in] batch 追加するデータ
+         */
+        template<class DataType>
+        void add(const std::size_t dim, const std::vector<DataType> &batch);
+
+
+        /** @brief 作成済みの coreset と merge-and-reduce の途中結果を破棄 */
+        void clear();
+
+
+        /** @brief coreset の各点 */
+        const std::vector< std::vector<double> > & getPoints() const;
+
+
+        /** @brief coreset の各点の重み (重みの和は元のデータ数の推定値) */
+        const std::vector<double> & getWeights() const;
+
+
+    private:
+        /**
+         * @brief coreset_size 個に縮小
+         * @param[in] weights 各データの重み (NULL なら全て 1)
+         * @param[out] points 抽出した点
+         * @param[out] point_weights 抽出した点の重み
+         */
+        template<class DataType>
+        void reduce(const std::size_t dim, const std::vector<DataType> &dataset, const std::vector<double> *weights,
+                    std::vector< std::vector<double> > &points, std::vector<double> &point_weights);
+
+
+        /**
+         * @brief 各データの重要度 (抽出確率に比例する値)
+         * @param[out] importances 各データの重要度
+         * @return 重要度の総和
+         */
+        template<class DataType>
+        double calcImportances(const std::vector<DataType> &dataset, const std::vector<double> *weights, std::vector<double> &importances);
+
+
+        /** @brief merge-and-reduce の各段をまとめて結果にする */
+        void collectBuckets();
+
+
+        /** @brief merge-and-reduce の各段の coreset */
+        struct Bucket
+        {
+            std::vector< std::vector<double> > points;
+            std::vector<double> weights;
+        };
+
+
+        /** @brief 抽出数 */
+        std::size_t m_coreset_size;
+
+
+        /** @brief 重要度の計算方法 */
+        Method m_method;
+
+
+        /** @brief Coreset::SENSITIVITY で使うクラスタ数 */
+        std::size_t m_num_clusters;
+
+
+        /** @brief クラスタリングするデータの次数 */
+        std::size_t m_dim;
+
+
+        /** @brief coreset の各点 */
+        std::vector< std::vector<double> > m_points;
+
+
+        /** @brief coreset の各点の重み */
+        std::vector<double> m_weights;
+
+
+        /** @brief merge-and-reduce の各段 (i 段目は 2^i 個のバッチ分、空なら未使用) */
+        std::vector<Bucket> m_buckets;
+
+
+        /** @brief Coreset::SENSITIVITY の k-means++ */
+        KMeans m_kmeans;
+
+
+        /** @brief 抽出に使う乱数器 */
+        std::mt19937 m_engine;
+
+    };  // end of coreset class
+
+
+
+
+    //------------------------------------------------------------------
+    // 実装部
+    //------------------------------------------------------------------
+
+    Coreset::Coreset()
+        : m_coreset_size(1000),
+          m_method(Coreset::SENSITIVITY),
+          m_num_clusters(10),
+          m_dim(0),
+          m_engine(scl::rng::makeEngine(scl::rng::randomSeed()))
+    {
+    }
+
+
+    void Coreset::setParameters(const std::size_t coreset_size, const Method method, const std::size_t num_clusters)
+    {
+        m_coreset_size = coreset_size;
+        m_method = method;
+        m_num_clusters = num_clusters;
+    }
+
+
+    void Coreset::setSeed(const std::uint64_t seed)
+    {
+        m_engine = scl::rng::makeEngine(seed);
+        m_kmeans.setSeed(scl::rng::streamSeed(seed, 0));
+    }
+
+
+    template<class DataType>
+    void Coreset::build(const std::size_t dim, const std::vector<DataType> &dataset)
+    {
+        m_dim = dim;
+        m_buckets.clear();
+        reduce(dim, dataset, NULL, m_points, m_weights);
+    }
+
+
+    template<class DataType>
+    void Coreset::build(const std::size_t dim, const std::vector<DataType> &dataset, const std::vector<double> &weights)
+    {
+        m_dim = dim;
+        m_buckets.clear();
+        if (weights.size() != dataset.size())
+        {
+            m_points.clear();
+            m_weights.clear();
+            return;
+        }
+        reduce(dim, dataset, &weights, m_points, m_weights);
+    }
+
+
+    template<class DataType>
+    void Coreset::add(const std::size_t dim, const std::vector<DataType> &batch)
+    {
+        if (dim == 0 || batch.empty())
+        {
+            return;
+        }
+        m_dim = dim;
+
+        // バッチを縮小して 0 段目へ //
+        Bucket carry;
+        reduce(dim, batch, NULL, carry.points, carry.weights);
+
+        // 同じ段が埋まっていれば合わせて縮小し、次の段へ繰り上げる //
+        std::size_t level(0);
+        for (; level < m_buckets.size() && !m_buckets[level].points.empty(); ++level)
+        {
+            Bucket &bucket(m_buckets[level]);
+            bucket.points.insert(bucket.points.end(), carry.points.begin(), carry.points.end());
+            bucket.weights.insert(bucket.weights.end(), carry.weights.begin(), carry.weights.end());
+            reduce(dim, bucket.points, &bucket.weights, carry.points, carry.weights);
+
+            bucket.points.clear();
+            bucket.weights.clear();
+        }
+        if (level == m_buckets.size())
+        {
+            m_buckets.push_back(Bucket());
+        }
+        m_buckets[level].points.swap(carry.points);
+        m_buckets[level].weights.swap(carry.weights);
+
+        collectBuckets();
+    }
+
+
+    void Coreset::clear()
+    {
+        m_points.clear();
+        m_weights.clear();
+        m_buckets.clear();
+    }
+
+
+    const std::vector< std::vector<double> >& Coreset::getPoints() const
+    {
+        return m_points;
+    }
+
+
+    const std::vector<double>& Coreset::getWeights() const
+    {
+        return m_weights;
+    }
+
+
+    void Coreset::collectBuckets()
+    {
+        m_points.clear();
+        m_weights.clear();
+        for (std::size_t level = 0; level < m_buckets.size(); ++level)
+        {
+            m_points.insert(m_points.end(), m_buckets[level].points.begin(), m_buckets[level].points.end());
+            m_weights.insert(m_weights.end(), m_buckets[level].weights.begin(), m_buckets[level].weights.end());
+        }
+    }
+
+
+    template<class DataType>
+    void Coreset::reduce(const std::size_t dim, const std::vector<DataType> &dataset, const std::vector<double> *weights,
+                         std::vector< std::vector<double> > &points, std::vector<double> &point_weights)
+    {
+        const std::size_t num_data(dataset.size());
+        std::vector< std::vector<double> > sampled_points;
+        std::vector<double> sampled_weights;
+
+        // 抽出数以下ならそのまま //
+        if (num_data <= m_coreset_size)
+        {
+            for (std::size_t data_index = 0; data_index < num_data; ++data_index)
+            {
+                std::vector<double> point(dim);
+                for (std::size_t value_index = 0; value_index < dim; ++value_index)
+                {
+                    point[value_index] = static_cast<double>(dataset[data_index][value_index]);
+                }
+                sampled_points.push_back(point);
+                sampled_weights.push_back(weights == NULL ? 1.0 : (*weights)[data_index]);
+            }
+            points.swap(sampled_points);
+            point_weights.swap(sampled_weights);
+            return;
+        }
+
+        // 重要度 //
+        std::vector<double> importances;
+        const double sum_importance = calcImportances(dataset, weights, importances);
+
+        // 重要度に比例した確率で復元抽出 (閾値を昇順に並べて1回の走査で選ぶ) //
+        std::uniform_real_distribution<double> threshold_distribution(0.0, 1.0);
+        std::vector<double> thresholds(m_coreset_size);
+        for (std::size_t sample_index = 0; sample_index < m_coreset_size; ++sample_index)
+        {
+            thresholds[sample_index] = sum_importance * threshold_distribution(m_engine);
+        }
+        std::sort(thresholds.begin(), thresholds.end());
+        std::vector<std::size_t> sampled_indices(m_coreset_size, 0);
+        KMeans::sampleIndices(importances, thresholds, sampled_indices);
+
+        // 重み = データの重み / (抽出数 x 確率) (同じデータが複数回選ばれたら足し合わせる) //
+        const double num_samples(static_cast<double>(m_coreset_size));
+        for (std::size_t sample_index = 0; sample_index < m_coreset_size; ++sample_index)
+        {
+            const std::size_t data_index(sampled_indices[sample_index]);
+            const double data_weight(weights == NULL ? 1.0 : (*weights)[data_index]);
+            const double weight = data_weight * sum_importance / (num_samples * importances[data_index]);
+
+            if (sample_index > 0 && sampled_indices[sample_index - 1] == data_index)
+            {
+                sampled_weights.back() += weight;
+                continue;
+            }
+
+            std::vector<double> point(dim);
+            for (std::size_t value_index = 0; value_index < dim; ++value_index)
+            {
+                point[value_index] = static_cast<double>(dataset[data_index][value_index]);
+            }
+            sampled_points.push_back(point);
+            sampled_weights.push_back(weight);
+        }
+        points.swap(sampled_points);
+        point_weights.swap(sampled_weights);
+    }
+
+
+    template<class DataType>
+    double Coreset::calcImportances(const std::vector<DataType> &dataset, const std::vector<double> *weights, std::vector<double> &importances)
+    {
+        // set size data
+        const std::size_t dim(m_dim);
+        const std::size_t num_data(dataset.size());
+        std::vector<double> data_weights(num_data, 1.0);
+        if (weights != NULL)
+        {
+            data_weights = *weights;
+        }
+        const double total_weight = scl::parallel::sum(num_data, [&](const std::size_t data_index) { return data_weights[data_index]; });
+
+
+        // 重心 (LIGHTWEIGHT は全体の平均、SENSITIVITY は k-means++) //
+        std::vector< std::vector<double> > centers;
+        if (m_method == Coreset::SENSITIVITY)
+        {
+            m_kmeans.initCentroids(dim, dataset, data_weights, std::min(m_num_clusters, num_data), centers, KMeans::PLUSPLUS);
+        }
+        else
+        {
+            std::vector<double> mean(dim, 0.0);
+            for (std::size_t data_index = 0; data_index < num_data; ++data_index)
+            {
+                for (std::size_t value_index = 0; value_index < dim; ++value_index)
+                {
+                    mean[value_index] += data_weights[data_index] * static_cast<double>(dataset[data_index][value_index]);
+                }
+            }
+            for (std::size_t value_index = 0; value_index < dim; ++value_index)
+            {
+                mean[value_index] /= total_weight;
+            }
+            centers.push_back(mean);
+        }
+        const std::size_t num_centers(centers.size());
+
+
+        // 最近傍の重心と距離の2乗 //
+        std::vector<std::size_t> nearest_list(num_data, 0);
+        std::vector<double> distance_list(num_data, 0.0);
+        #pragma omp parallel for
+        for (std::size_t data_index = 0; data_index < num_data; ++data_index)
+        {
+            double min_squared_distance(std::numeric_limits<double>::max());
+            for (std::size_t center_index = 0; center_index < num_centers; ++center_index)
+            {
+                double squared_distance(0.0);
+                for (std::size_t value_index = 0; value_index < dim; ++value_index)
+                {
+                    const double error = static_cast<double>(dataset[data_index][value_index]) - centers[center_index][value_index];
+                    squared_distance += error * error;
+                }
+                if (squared_distance < min_squared_distance)
+                {
+                    min_squared_distance = squared_distance;
+                    nearest_list[data_index] = center_index;
+                }
+            }
+            distance_list[data_index] = min_squared_distance;
+        }
+
+
+        // 各重心の重みの和と評価値 //
+        std::vector<double> center_weights(num_centers, 0.0), center_costs(num_centers, 0.0);
+        for (std::size_t data_index = 0; data_index < num_data; ++data_index)
+        {
+            center_weights[nearest_list[data_index]] += data_weights[data_index];
+            center_costs[nearest_list[data_index]] += data_weights[data_index] * distance_list[data_index];
+        }
+        double total_cost(0.0);
+        for (std::size_t center_index = 0; center_index < num_centers; ++center_index)
+        {
+            total_cost += center_costs[center_index];
+        }
+
+
+        // 全データが重心と一致していれば重みに比例 //
+        importances.resize(num_data);
+        if (total_cost <= 0.0)
+        {
+            importances = data_weights;
+            return total_weight;
+        }
+
+
+        // importance //
+        if (m_method == Coreset::SENSITIVITY)
+        {
+            // s(x) = α d(x)^2 / c + 2α φ(B) / (|B| c) + 4 |X| / |B|  (c = 全体の平均評価値, α = 16 (log k + 2)) //
+            const double alpha = 16.0 * (std::log(static_cast<double>(num_centers)) + 2.0);
+            const double mean_cost = total_cost / total_weight;
+            #pragma omp parallel for
+            for (std::size_t data_index = 0; data_index < num_data; ++data_index)
+            {
+                const std::size_t center_index(nearest_list[data_index]);
+                const double sensitivity = ( alpha * distance_list[data_index] / mean_cost
+                                             + 2.0 * alpha * center_costs[center_index] / (center_weights[center_index] * mean_cost)
+                                             + 4.0 * total_weight / center_weights[center_index] );
+                importances[data_index] = data_weights[data_index] * sensitivity;
+            }
+        }
+        else
+        {
+            // q(x) = 1/2 w / W + 1/2 w d(x, μ)^2 / Σ w d^2 //
+            #pragma omp parallel for
+            for (std::size_t data_index = 0; data_index < num_data; ++data_index)
+            {
+                importances[data_index] = ( 0.5 * data_weights[data_index] / total_weight
+                                            + 0.5 * data_weights[data_index] * distance_list[data_index] / total_cost );
+            }
+        }
+        return scl::parallel::sum(num_data, [&](const std::size_t data_index) { return importances[data_index]; });
+    }
+
+} // end of namespace scl
+
+
+#endif  /* SCL_CORESET_HPP */
@@ -0,0 +1,530 @@
+/**
+ * @file FixedKMeans.hpp
+ * @brief This class implements the k-means clustering algorithm for a fixed (compile-time) dimension.
+ */
+
+#ifndef SCL_FIXED_K_MEANS_HPP
+#define SCL_FIXED_K_MEANS_HPP
+
+#include <scl/clustering/KMeans.hpp>
+#include <array>
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+namespace scl
+{
+    namespace internal {
+        /**
+         * @brief 次元数が固定の距離の2乗 (テンプレートの再帰で展開)
+         * @tparam Index 先頭から Index 個の要素を計算する
+         */
+        template<std::size_t Index>
+        struct FixedSquaredDistance
+        {
+            template<class PointTypeA, class PointTypeB>
+            static double calc(const PointTypeA &point_a, const PointTypeB &point_b)
+            {
+                const double value_error = static_cast<double>(point_a[Index - 1]) - static_cast<double>(point_b[Index - 1]);
+                return FixedSquaredDistance<Index - 1>::calc(point_a, point_b) + value_error * value_error;
+            }
+        };
+
+
+        template<>
+        struct FixedSquaredDistance<0>
+        {
+            template<class PointTypeA, class PointTypeB>
+            static double calc(const PointTypeA &, const PointTypeB &)
+            {
+                return 0.0;
+            }
+        };
+
+    } // end namespace internal
+
+
+    /**
+     * @class FixedKMeans
+     * @brief 次元数をコンパイル時に固定した k-means clustering.
+     * @tparam Dim データの次元数 (2, 3, 4 など低次元向け)
+     * @details クラスタ重心を連続領域の std::array<double, Dim> で持ち、距離計算を展開する。
+     * データが std::array<double, Dim> 以外なら1回だけ連続領域にコピーする。 @n
+     * 初期化は KMeans::initCentroids を使い、重心計算と空クラスタの再設定は KMeans と共通の internal::sumCentroids, internal::reseedEmptyClusters を使う。
+     * ラベル更新は総当たりのみなので、クラスタ数が多い (32 以上程度) ときは KMeans::FILTERING の方が速い
+     * @see KMeans
+     */
+    template<std::size_t Dim>
+    class FixedKMeans
+    {
+    public:
+        /** @brief クラスタ重心・データの型 */
+        typedef std::array<double, Dim> PointType;
+
+
+        /** @brief コンストラクタ */
+        FixedKMeans();
+
+
+        /**
+         * @brief クラスタリング時のパラメータ設定
+         * @see KMeans::setParameters
+         */
+        void setParameters(const std::size_t max_iteration, const double tolerance, const std::size_t max_pp_trial=3);
+
+
+        /**
+         * @brief 乱数のシードを設定
+         * @see KMeans::setSeed
+         */
+        void setSeed(const std::uint64_t seed);
+
+
+        /**
+         * @brief クラスタリング
+         * @tparam DataType クラスタリングするデータの型
+         * @param[in] dim DataTypeの次数 (Dim と違えば失敗)
+         * @param[in] dataset クラスタリングするデータセット
+         * @param[in] num_clusters クラスタ数
+         * @param[in,out] centroids 各クラスタの重心位置 (KMeans::MANUAL なら初期値)
+         * @param[in] method クラスタ重心の初期化方法
+         * @return 収束したか
+         * @attention DataType needs [] access operator
+         * @see KMeans::clustering
+         */
+        template<class DataType>
+        bool clustering(const std::size_t dim, const std::vector<DataType> &dataset, const std::size_t num_clusters, std::vector< std::vector<double> > &centroids, const KMeans::InitMethod method=KMeans::PLUSPLUS);
+
+
+        /**
+         * @brief クラスタリング (結果は FixedKMeans::getCentroids で取得)
+         * @details std::array<double, Dim> のデータはコピーせずにそのまま使う
+         * @see FixedKMeans::clustering
+         */
+        template<class DataType>
+        bool clustering(const std::vector<DataType> &dataset, const std::size_t num_clusters, const KMeans::InitMethod method=KMeans::PLUSPLUS);
+
+
+        /**
+         * @brief 最近傍クラスタの取得
+         * @param[in] point 対象データ
+         * @return クラスタID
+         */
+        template<class DataType>
+        std::size_t predict(const DataType &point) const;
+
+
+        /** @brief 各クラスタの重心位置 */
+        const std::vector<PointType> & getCentroids() const;
+
+
+        /**
+         * @brief 全クラスタの情報取得
+         * @see ClusterLabels::getClusters
+         */
+        const std::vector< std::vector<std::size_t> > & getClusters() const;
+
+
+        /**
+         * @brief 指定したクラスタの情報取得
+         * @see ClusterLabels::getCluster
+         */
+        const std::vector<std::size_t> & getCluster(const std::size_t cluster_id) const;
+
+
+        /** @brief 各データのクラスタID */
+        const std::vector<std::uint32_t> & getLabels() const;
+
+
+        /**
+         * @brief クラスタリング結果 (ラベル配列と CSR 形式のクラスタごとのデータ)
+         * @see ClusterLabels
+         */
+        const ClusterLabels & getClusterLabels() const;
+
+
+        /** @brief 直前のクラスタリング結果の情報 */
+        const KMeans::Result & getResult() const;
+
+
+        /** @brief 距離の2乗 (展開済み) */
+        template<class DataTypeA, class DataTypeB>
+        static double calcSquaredDistance(const DataTypeA &point_a, const DataTypeB &point_b);
+
+
+    private:
+        /**
+         * @brief 連続領域のデータでクラスタリング
+         * @param[in] dataset クラスタリングするデータセット
+         * @param[in] method クラスタ重心の初期化方法 (KMeans::MANUAL なら FixedKMeans::m_centroids が初期値)
+         */
+        bool clusteringPoints(const std::vector<PointType> &dataset, const std::size_t num_clusters, const KMeans::InitMethod method);
+
+
+        /**
+         * @brief 最近傍クラスタ
+         * @param[out] squared_distance 最近傍クラスタ重心との距離の2乗
+         */
+        template<class DataType>
+        std::size_t findNearest(const DataType &point, double &squared_distance) const;
+
+
+        /**
+         * @brief ラベルの更新
+         * @return 前回からラベルが変わったデータ数 (前回のラベルがなければデータ数)
+         */
+        std::size_t updateLabel(const std::vector<PointType> &dataset);
+
+
+        /**
+         * @brief クラスタ重心の計算と空のクラスタの再設定
+         * @return 再設定したクラスタ数
+         * @see internal::sumCentroids
+         * @see internal::reseedEmptyClusters
+         */
+        std::size_t updateCentroids(const std::vector<PointType> &dataset);
+
+
+        /** @brief データを連続領域にコピー */
+        template<class DataType>
+        static void toPoints(const std::vector<DataType> &dataset, std::vector<PointType> &points);
+
+
+        /**
+         * @brief 連続領域のデータ
+         * @param[out] buffer コピーする場合のバッファ
+         * @return std::array<double, Dim> のデータならそのまま、それ以外は buffer にコピーして返す
+         */
+        template<class DataType>
+        static const std::vector<PointType> & asPoints(const std::vector<DataType> &dataset, std::vector<PointType> &buffer);
+
+
+        /** @brief 連続領域のデータ (コピーしない) */
+        static const std::vector<PointType> & asPoints(const std::vector<PointType> &dataset, std::vector<PointType> &buffer);
+
+
+        /** @brief 初期化に使う k-means */
+        KMeans m_kmeans;
+
+
+        /** @brief 最大試行回数 */
+        std::size_t m_max_iteration;
+
+
+        /** @brief 収束判定閾値 */
+        double m_tolerance;
+
+
+        /** @brief 各クラスタの重心位置 */
+        std::vector<PointType> m_centroids;
+
+
+        /** @brief 各データのクラスタID */
+        ClusterLabels m_labels;
+
+
+        /** @brief 直前のクラスタリング結果の情報 */
+        KMeans::Result m_result;
+
+    };  // end of fixed k-means class
+
+
+
+
+    //------------------------------------------------------------------
+    // 実装部
+    //------------------------------------------------------------------
+
+    template<std::size_t Dim>
+    FixedKMeans<Dim>::FixedKMeans()
+        : m_max_iteration(10),
+          m_tolerance(0.1)
+    {
+        m_result.inertia = 0.0;
+        m_result.num_iterations = 0;
+        m_result.is_converged = false;
+    }
+
+
+    template<std::size_t Dim>
+    void FixedKMeans<Dim>::setParameters(const std::size_t max_iteration, const double tolerance, const std::size_t max_pp_trial)
+    {
+        m_max_iteration = max_iteration;
+        m_tolerance = tolerance;
+        m_kmeans.setParameters(max_iteration, tolerance, max_pp_trial);
+    }
+
+
+    template<std::size_t Dim>
+    void FixedKMeans<Dim>::setSeed(const std::uint64_t seed)
+    {
+        m_kmeans.setSeed(seed);
+    }
+
+
+    template<std::size_t Dim>
+    template<class DataType>
+    bool FixedKMeans<Dim>::clustering(const std::size_t dim, const std::vector<DataType> &dataset, const std::size_t num_clusters, std::vector< std::vector<double> > &centroids, const KMeans::InitMethod method)
+    {
+        // size check
+        if (dim != Dim)
+        {
+            return false;
+        }
+
+        // 初期値 //
+        if (method == KMeans::MANUAL)
+        {
+            for (std::size_t cluster_index = 0; cluster_index < centroids.size(); ++cluster_index)
+            {
+                if (centroids[cluster_index].size() != Dim)
+                {
+                    return false;
+                }
+            }
+            toPoints(centroids, m_centroids);
+        }
+
+        std::vector<PointType> buffer;
+        bool is_converged = clusteringPoints(asPoints(dataset, buffer), num_clusters, method);
+
+        // 結果を KMeans と同じ形式で返す //
+        centroids.resize(m_centroids.size());
+        for (std::size_t cluster_index = 0; cluster_index < m_centroids.size(); ++cluster_index)
+        {
+            centroids[cluster_index].assign(m_centroids[cluster_index].begin(), m_centroids[cluster_index].end());
+        }
+        return is_converged;
+    }
+
+
+    template<std::size_t Dim>
+    template<class DataType>
+    bool FixedKMeans<Dim>::clustering(const std::vector<DataType> &dataset, const std::size_t num_clusters, const KMeans::InitMethod method)
+    {
+        std::vector<PointType> buffer;
+        return clusteringPoints(asPoints(dataset, buffer), num_clusters, method);
+    }
+
+
+    template<std::size_t Dim>
+    bool FixedKMeans<Dim>::clusteringPoints(const std::vector<PointType> &dataset, const std::size_t num_clusters, const KMeans::InitMethod method)
+    {
+        // size check
+        const std::size_t num_data(dataset.size());
+        if (num_data == 0 || num_clusters == 0 || (method == KMeans::MANUAL && m_centroids.size() != num_clusters))
+        {
+            return false;
+        }
+
+
+        // クラスタ重心の初期化 //
+        if (method != KMeans::MANUAL)
+        {
+            std::vector< std::vector<double> > centroids;
+            m_kmeans.initCentroids(Dim, dataset, num_clusters, centroids, method);
+            toPoints(centroids, m_centroids);
+        }
+        m_labels.clear();
+
+
+        // k-means
+        bool is_converged(false);
+        std::vector<PointType> pre_centroids;
+        bool is_reseeded(false);
+        std::size_t iteration(0);
+        while (iteration < m_max_iteration)
+        {
+            ++iteration;
+
+            // update label
+            const std::size_t num_changed( updateLabel(dataset) );
+
+            // ラベルが1つも変わらなければ重心も変わらないので終了 //
+            if (!is_reseeded && num_changed == 0)
+            {
+                is_converged = true;
+                break;
+            }
+
+            // update centroids
+            pre_centroids = m_centroids;
+            is_reseeded = ( updateCentroids(dataset) > 0 );
+
+            // check converged
+            double max_change(0.0);
+            for (std::size_t cluster_index = 0; cluster_index < num_clusters; ++cluster_index)
+            {
+                max_change = std::max(max_change, calcSquaredDistance(m_centroids[cluster_index], pre_centroids[cluster_index]));
+            }
+            if (!is_reseeded && max_change < m_tolerance)
+            {
+                is_converged = true;
+                break;
+            }
+        }
+
+
+        // save result
+        const std::vector<std::uint32_t> &labels(m_labels.getLabels());
+        m_result.inertia = scl::parallel::sum(num_data, [&](const std::size_t data_index)
+        {
+            return calcSquaredDistance(dataset[data_index], m_centroids[labels[data_index]]);
+        });
+        m_result.num_iterations = iteration;
+        m_result.is_converged = is_converged;
+
+        return is_converged;
+    }
+
+
+    template<std::size_t Dim>
+    template<class DataType>
+    std::size_t FixedKMeans<Dim>::predict(const DataType &point) const
+    {
+        double squared_distance(0.0);
+        return findNearest(point, squared_distance);
+    }
+
+
+    template<std::size_t Dim>
+    const std::vector<typename FixedKMeans<Dim>::PointType>& FixedKMeans<Dim>::getCentroids() const
+    {
+        return m_centroids;
+    }
+
+
+    template<std::size_t Dim>
+    const std::vector< std::vector<std::size_t> >& FixedKMeans<Dim>::getClusters() const
+    {
+        return m_labels.getClusters();
+    }
+
+
+    template<std::size_t Dim>
+    const std::vector<std::size_t>& FixedKMeans<Dim>::getCluster(const std::size_t cluster_id) const
+    {
+        return m_labels.getCluster(cluster_id);
+    }
+
+
+    template<std::size_t Dim>
+    const std::vector<std::uint32_t>& FixedKMeans<Dim>::getLabels() const
+    {
+        return m_labels.getLabels();
+    }
+
+
+    template<std::size_t Dim>
+    const ClusterLabels& FixedKMeans<Dim>::getClusterLabels() const
+    {
+        return m_labels;
+    }
+
+
+    template<std::size_t Dim>
+    const KMeans::Result& FixedKMeans<Dim>::getResult() const
+    {
+        return m_result;
+    }
+
+
+    template<std::size_t Dim>
+    template<class DataTypeA, class DataTypeB>
+    double FixedKMeans<Dim>::calcSquaredDistance(const DataTypeA &point_a, const DataTypeB &point_b)
+    {
+        return internal::FixedSquaredDistance<Dim>::calc(point_a, point_b);
+    }
+
+
+    template<std::size_t Dim>
+    template<class DataType>
+    std::size_t FixedKMeans<Dim>::findNearest(const DataType &point, double &squared_distance) const
+    {
+        const std::size_t num_clusters(m_centroids.size());
+        const PointType *centroids(m_centroids.data());
+        std::size_t nearest_cluster_index(0);
+        squared_distance = std::numeric_limits<double>::max();
+        for (std::size_t cluster_index = 0; cluster_index < num_clusters; ++cluster_index)
+        {
+            double new_squared_distance = calcSquaredDistance(point, centroids[cluster_index]);
+            if (new_squared_distance < squared_distance)
+            {
+                squared_distance = new_squared_distance;
+                nearest_cluster_index = cluster_index;
+            }
+        }
+        return nearest_cluster_index;
+    }
+
+
+    template<std::size_t Dim>
+    std::size_t FixedKMeans<Dim>::updateLabel(const std::vector<PointType> &dataset)
+    {
+        // 前回のラベルがなければ全て変わったとみなす //
+        const std::size_t num_data(dataset.size());
+        const bool has_labels(m_labels.getLabels().size() == num_data);
+
+        // 変わったデータ数はラベルを書き込むときに数える //
+        std::vector<std::uint32_t> &labels = m_labels.resetLabels(num_data, m_centroids.size());
+        std::size_t num_changed(0);
+        #pragma omp parallel for reduction(+:num_changed)
+        for (std::size_t data_index = 0; data_index < num_data; ++data_index)
+        {
+            double squared_distance(0.0);
+            const std::uint32_t nearest_cluster_index = static_cast<std::uint32_t>(findNearest(dataset[data_index], squared_distance));
+            num_changed += (labels[data_index] != nearest_cluster_index) ? 1 : 0;
+            labels[data_index] = nearest_cluster_index;
+        }
+        return has_labels ? num_changed : num_data;
+    }
+
+
+    template<std::size_t Dim>
+    std::size_t FixedKMeans<Dim>::updateCentroids(const std::vector<PointType> &dataset)
+    {
+        // KMeans と同じ計算 (重みは全て 1) //
+        std::vector<double> weight_sums;
+        internal::sumCentroids(Dim, dataset, m_labels.getLabels(), [](const std::size_t) { return 1.0; }, m_centroids, weight_sums);
+        internal::averageCentroids(Dim, weight_sums, m_centroids);
+
+        return internal::reseedEmptyClusters(Dim, dataset,
+                                             [](const std::size_t) { return 1.0; },
+                                             [&](const std::size_t data_index, const PointType &centroid) { return calcSquaredDistance(dataset[data_index], centroid); },
+                                             NULL, m_labels.getMutableLabels(), m_centroids);
+    }
+
+
+    template<std::size_t Dim>
+    template<class DataType>
+    void FixedKMeans<Dim>::toPoints(const std::vector<DataType> &dataset, std::vector<PointType> &points)
+    {
+        points.resize(dataset.size());
+        for (std::size_t data_index = 0; data_index < dataset.size(); ++data_index)
+        {
+            for (std::size_t value_index = 0; value_index < Dim; ++value_index)
+            {
+                points[data_index][value_index] = static_cast<double>(dataset[data_index][value_index]);
+            }
+        }
+    }
+
+    template<std::size_t Dim>
+    template<class DataType>
+    const std::vector<typename FixedKMeans<Dim>::PointType>& FixedKMeans<Dim>::asPoints(const std::vector<DataType> &dataset, std::vector<PointType> &buffer)
+    {
+        toPoints(dataset, buffer);
+        return buffer;
+    }
+
+
+    template<std::size_t Dim>
+    const std::vector<typename FixedKMeans<Dim>::PointType>& FixedKMeans<Dim>::asPoints(const std::vector<PointType> &dataset, std::vector<PointType> &)
+    {
+        return dataset;
+    }
+
+} // end of namespace scl
+
+
+#endif  /* SCL_FIXED_K_MEANS_HPP */
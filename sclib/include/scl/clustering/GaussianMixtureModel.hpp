@@ -8,13 +8,15 @@
 #include <scl/util/Statistics.hpp>
 #include <scl/util/EigenUtil.hpp>
 #include <scl/clustering/KMeans.hpp>
+#include <scl/util/Random.hpp>
+#include <scl/util/Parallel.hpp>
 #include <vector>
-#include <numeric>    // iota
-#include <algorithm>  // shuffle
+#include <cmath>
+#include <limits>
+#include <numeric>    // iota, accumulate
+#include <algorithm>  // shuffle, max
 #include <random>     // random
-
-#include <iostream>   // debug
-#define PRINT_MAT(X) std::cout << #X << ":\n" << X << std::endl << std::endl
+#include <Eigen/Cholesky>
 
 namespace scl
 {
@@ -36,33 +38,120 @@ namespace scl
         /** @brief コンストラクタ */
         GaussianMixtureModel();
 
+
+        /**
+         * @brief 乱数のシードを設定
+         * @see KMeans::setSeed
+         */
+        void setSeed(const std::uint64_t seed);
+
+
         template<class DataType>
         bool clustering(const std::size_t dim, const std::vector<DataType> &dataset, const std::size_t num_clusters, std::vector< std::vector<double> > &centroids);
 
+
+        /**
+         * @brief 重み付きデータのクラスタリング
+         * @details 重み w のデータは w 個の同じデータとして扱う (M-step、混合係数、BIC が重み付きになる)
+         * @param[in] weights 各データの重み (dataset と同じサイズ、正の値)
+         */
+        template<class DataType>
+        bool clustering(const std::size_t dim, const std::vector<DataType> &dataset, const std::vector<double> &weights, const std::size_t num_clusters, std::vector< std::vector<double> > &centroids);
+
         
         /** 
          * @brief 全クラスタの情報取得
-         * @see KMeans::m_clusterid_to_dataids
+         * @see ClusterLabels::getClusters
          */
         const std::vector< std::vector<std::size_t> > & getClusters() const;
 
 
         /**
          * @brief 指定したクラスタの情報取得
-         * @see KMeans::m_clusterid_to_dataids
+         * @see ClusterLabels::getCluster
          */
         const std::vector<std::size_t> & getCluster(const std::size_t cluster_id) const;
 
+
+        /** @brief 各データのクラスタID (負担率が最大のクラスタ) */
+        const std::vector<std::uint32_t> & getLabels() const;
+
+
+        /**
+         * @brief クラスタリング結果 (ラベル配列と CSR 形式のクラスタごとのデータ)
+         * @see ClusterLabels
+         */
+        const ClusterLabels & getClusterLabels() const;
+
         double calcBIC(const Eigen::MatrixXd &dataset);
                 
         
     private:
+        /** @brief 行優先の行列 (1データ = 1行が連続する) */
+        typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> RowMatrix;
+
+
+        /** @brief EM アルゴリズム本体 */
+        template<class DataType>
+        bool runEM(const std::size_t dim, const std::vector<DataType> &dataset, const std::size_t num_clusters, std::vector< std::vector<double> > &centroids);
+
+        /** @brief データの重み (重みなしなら 1) */
+        double sampleWeight(const std::size_t data_index) const;
+
+        /** @brief 重みの総和 (重みなしならデータ数) */
+        double totalWeight(const std::size_t num_data) const;
+
         template<class DataType>
         void initialize2(const std::vector<DataType> &dataset);
         
         void initialize(const Eigen::MatrixXd &dataset);
-        void expectationStep(const Eigen::MatrixXd &dataset);
-        void maximizationStep(const Eigen::MatrixXd &dataset);
+
+        /**
+         * @brief 負担率の計算
+         * @details 対数空間で求めて log-sum-exp で正規化する。 O(N・k・dim^2)。
+         * データの行ごとに独立なので並列に求める
+         */
+        void expectationStep(const RowMatrix &dataset);
+
+
+        /**
+         * @brief 平均、混合係数、共分散行列の更新
+         * @details 負担率の和、重み付き和、重み付き散布行列を1回の走査でまとめて集計する。
+         * データのブロック (block_size 行) ごとに行列積で求め、スレッドごとの部分和をスレッド番号順に足し合わせる
+         * (スレッド数が同じなら結果も同じ)。桁落ちしないよう更新前の平均からの差で集計する
+         */
+        void maximizationStep(const RowMatrix &dataset);
+
+
+        /**
+         * @brief 対数尤度 \f$ \Sigma w log \Sigma_k \pi_k N(x | \mu_k, \Sigma_k) \f$
+         * @details 固定長のブロックごとの部分和をブロック順に足すので、スレッド数によらず同じ値になる
+         */
+        template<class Matrix>
+        double calcLogLikelihood(const Matrix &dataset) const;
+
+
+        /** @brief 対数尤度からの BIC */
+        double bayesianInformationCriterion(const double log_likelihood, const std::size_t num_data) const;
+
+
+        /**
+         * @brief 各クラスタの共分散行列を Cholesky 分解する (パラメータを更新するたびに1回)
+         * @details 正定値でなければ対角成分に小さい値を足して分解し直す
+         */
+        void factorizeCovariances();
+
+
+        /**
+         * @brief 1つのデータの各クラスタの \f$ log(\pi_k N(x | \mu_k, \Sigma_k)) \f$
+         * @details GaussianMixtureModel::factorizeCovariances の結果を使い、三角行列の求解で O(k・dim^2)
+         * @param[in] point 対象データ (Eigen の行ベクトル)
+         * @param[out] log_scores 各クラスタの値 (サイズ k)
+         * @param[in,out] err 作業領域 (サイズ dim)
+         * @return \f$ log \Sigma_k \pi_k N(x | \mu_k, \Sigma_k) \f$ (log-sum-exp)
+         */
+        template<class RowType>
+        double calcLogScores(const RowType &point, std::vector<double> &log_scores, Eigen::VectorXd &err) const;
         
         
         /** @brief クラスタリングするデータの次数 */
@@ -71,8 +160,8 @@ namespace scl
         /** @brief クラスタ数 */
         std::size_t m_num_clusters;
 
-        /** @brief 負担率 (N:データ数) x (k:クラスタ数) */
-        std::vector< std::vector<double> > m_gamma;
+        /** @brief 負担率 (N:データ数) x (k:クラスタ数)、1データの負担率が連続する */
+        RowMatrix m_gamma;
 
         /** @brief 各クラスタの正規化時の平均 (k x dim) */
         std::vector< Eigen::VectorXd, Eigen::aligned_allocator<Eigen::VectorXd> > m_mean;
@@ -83,13 +172,20 @@ namespace scl
         /** @brief 各クラスタの混合係数 (各正規分布の重み) */
         std::vector<double> m_pi;
 
-        /**
-         * @brief クラスタID(=index)ごとにデータIDを割り振った配列
-         * @par example
-         * data_indices = this[cluster_index] @n
-         * data_index = this[cluster_index][array_index]
-         */
-        std::vector< std::vector<std::size_t> > m_clusterid_to_dataids;
+        /** @brief 各クラスタの共分散行列の Cholesky 分解の下三角行列 L (k x dim x dim) */
+        std::vector< Eigen::MatrixXd, Eigen::aligned_allocator<Eigen::MatrixXd> > m_cholesky;
+
+        /** @brief 各クラスタの \f$ log \pi_k - \frac{1}{2} (dim \, log(2\pi) + log|\Sigma_k|) \f$ */
+        std::vector<double> m_log_coefficients;
+
+        /** @brief 各データのクラスタID */
+        ClusterLabels m_labels;
+
+        /** @brief 各データの重み (重みなしなら空) */
+        std::vector<double> m_weights;
+
+        /** @brief 初期化に使う乱数器 */
+        std::mt19937 m_engine;
     };
 
 
@@ -100,30 +196,92 @@ namespace scl
     //------------------------------------------------------------------
 
     GaussianMixtureModel::GaussianMixtureModel()
+        : m_engine(scl::rng::makeEngine(scl::rng::randomSeed()))
     {
     }
 
+
+    void GaussianMixtureModel::setSeed(const std::uint64_t seed)
+    {
+        m_engine = scl::rng::makeEngine(seed);
+    }
+
     
     const std::vector< std::vector<std::size_t> >& GaussianMixtureModel::getClusters() const
     {
-        return m_clusterid_to_dataids;
+        return m_labels.getClusters();
     }
 
 
     const std::vector<std::size_t>& GaussianMixtureModel::getCluster(const std::size_t cluster_id) const
     {
-        return m_clusterid_to_dataids.at(cluster_id);
+        return m_labels.getCluster(cluster_id);
+    }
+
+
+    const std::vector<std::uint32_t>& GaussianMixtureModel::getLabels() const
+    {
+        return m_labels.getLabels();
+    }
+
+
+    const ClusterLabels& GaussianMixtureModel::getClusterLabels() const
+    {
+        return m_labels;
     }
     
 
+    double GaussianMixtureModel::sampleWeight(const std::size_t data_index) const
+    {
+        return m_weights.empty() ? 1.0 : m_weights[data_index];
+    }
+
+
+    double GaussianMixtureModel::totalWeight(const std::size_t num_data) const
+    {
+        return m_weights.empty() ? static_cast<double>(num_data) : std::accumulate(m_weights.begin(), m_weights.end(), 0.0);
+    }
+
+
+    template<class DataType>
+    bool GaussianMixtureModel::clustering(const std::size_t dim, const std::vector<DataType> &dataset, const std::size_t num_clusters, std::vector< std::vector<double> > &centroids)
+    {
+        m_weights.clear();
+        return runEM(dim, dataset, num_clusters, centroids);
+    }
+
+
     template<class DataType>
-    bool GaussianMixtureModel::clustering(const std::size_t dim, const std::vector<DataType> &dataset_stl, const std::size_t num_clusters, std::vector< std::vector<double> > &centroids)
+    bool GaussianMixtureModel::clustering(const std::size_t dim, const std::vector<DataType> &dataset, const std::vector<double> &weights, const std::size_t num_clusters, std::vector< std::vector<double> > &centroids)
+    {
+        // size check
+        if (weights.size() != dataset.size())
+        {
+            return false;
+        }
+
+        m_weights = weights;
+        bool is_converged = runEM(dim, dataset, num_clusters, centroids);
+        m_weights.clear();
+        return is_converged;
+    }
+
+
+    template<class DataType>
+    bool GaussianMixtureModel::runEM(const std::size_t dim, const std::vector<DataType> &dataset_stl, const std::size_t num_clusters, std::vector< std::vector<double> > &centroids)
     {
         // set parameter
         const std::size_t N(dataset_stl.size());
         m_dim = dim;
         m_num_clusters = num_clusters;
-        Eigen::MatrixXd dataset( scl::toEigenMatrix(dim, dataset_stl) );
+        RowMatrix dataset(N, dim);
+        for (std::size_t j = 0; j < N; ++j)
+        {
+            for (std::size_t d = 0; d < dim; ++d)
+            {
+                dataset(j, d) = static_cast<double>(dataset_stl[j][d]);
+            }
+        }
         
 
         // initialize
@@ -132,8 +290,7 @@ namespace scl
 
 
         // reset gamma
-        m_gamma.clear();
-        m_gamma.resize(N, std::vector<double>(num_clusters, 0.0));
+        m_gamma.setZero(N, num_clusters);
 
 
         // EM algorithm
@@ -148,7 +305,7 @@ namespace scl
             maximizationStep(dataset);
 
             // calc BIC
-            double bic = calcBIC(dataset);
+            double bic = bayesianInformationCriterion(calcLogLikelihood(dataset), N);
             if ( (bic - pre_bic) > 0.001 )
             {
                 pre_bic = bic;
@@ -162,40 +319,21 @@ namespace scl
 
 
         // labelling
-        m_clusterid_to_dataids.clear();
-        m_clusterid_to_dataids.resize(num_clusters);
-        for (std::size_t j = 0; j < N; ++j)
+        std::vector<std::uint32_t> &labels = m_labels.resetLabels(N, num_clusters);
+        #pragma omp parallel
         {
-            std::size_t best_cluster_id(0);
-            double best_score(0.0);
-            for ( std::size_t k = 0; k < num_clusters; ++k)
-            {
-                double score = m_pi[k] * scl::normal::probabilityDensityFunction(dataset.row(j), m_mean[k], m_covariance[k]);
-                if (score > best_score)
-                {
-                    best_cluster_id = k;
-                    best_score = score;
-                }
-            }
-            m_clusterid_to_dataids[best_cluster_id].push_back(j);
-        }
-
+            std::vector<double> log_scores(num_clusters, 0.0);
+            Eigen::VectorXd err(dim);
 
-        for (int i = 0; i < N; ++i)
-        {
-            for (int j = 0; j < num_clusters; ++j)
+            #pragma omp for schedule(static)
+            for (std::size_t j = 0; j < N; ++j)
             {
-                printf("%8.4f", m_gamma[i][j]);
+                calcLogScores(dataset.row(j), log_scores, err);
+                labels[j] = static_cast<std::uint32_t>(std::max_element(log_scores.begin(), log_scores.end()) - log_scores.begin());
             }
-            std::cout << std::endl;
-        }
-        std::cout << "------------------------" << std::endl;
-        for (int i = 0; i < num_clusters; ++i)
-        {
-            printf("%8.4f", m_pi[i]);
         }
-        std::cout << std::endl;
-        std::cout << pre_bic << std::endl;
+
+        return is_converged;
     }
 
     
@@ -210,9 +348,25 @@ namespace scl
 
         // k-means initialize
         scl::KMeans kmeans;
+        kmeans.setSeed(m_engine());
         std::vector< std::vector<double> > centroids;
-        kmeans.clustering(dim, dataset, num_clusters, centroids);
-        m_clusterid_to_dataids = kmeans.getClusters();
+        if (m_weights.empty())
+        {
+            kmeans.clustering(dim, dataset, num_clusters, centroids);
+        }
+        else
+        {
+            kmeans.clustering(dim, dataset, m_weights, num_clusters, centroids);
+        }
+        m_labels = kmeans.getClusterLabels();
+
+        // 各クラスタの重みの和 //
+        std::vector<double> cluster_weights(num_clusters, 0.0);
+        for (std::size_t j = 0; j < N; ++j)
+        {
+            cluster_weights[m_labels.getLabels()[j]] += sampleWeight(j);
+        }
+        const double total_weight(totalWeight(N));
 
 
         // reset data
@@ -224,24 +378,25 @@ namespace scl
         // init
         for (std::size_t k = 0; k < num_clusters; ++k)
         {
-            double Nk(m_clusterid_to_dataids[k].size());
+            double Nk(cluster_weights[k]);
             
             // calc mean
             m_mean[k] = scl::toEigenVector(dim, centroids[k]);
             
             // calc pi
-            m_pi[k] = Nk / static_cast<double>(N);
+            m_pi[k] = Nk / total_weight;
 
             // calc covariance
-            // for (std::size_t j = 0; j < m_clusterid_to_dataids[k].size(); ++j)
+            // for (std::size_t j = 0; j < m_labels.getCluster(k).size(); ++j)
             // {
-            //     std::size_t data_index = m_clusterid_to_dataids[k][j];
+            //     std::size_t data_index = m_labels.getCluster(k)[j];
             //     Eigen::VectorXd err = scl::toEigenVector(dim, dataset.at(data_index)) - m_mean[k];
             //     m_covariance[k] += err * err.transpose();
             // }
             // m_covariance[k] /= Nk;
             m_covariance[k] = Eigen::MatrixXd::Identity(dim, dim);
         }
+        factorizeCovariances();
     }
         
     
@@ -259,20 +414,19 @@ namespace scl
 
         
         // シャッフル //
-        std::random_device seed_gen;
-        std::mt19937 engine(seed_gen());
-        std::shuffle(shuffle_indices.begin(), shuffle_indices.end(), engine);
+        std::shuffle(shuffle_indices.begin(), shuffle_indices.end(), m_engine);
 
         
         // init label
-        m_clusterid_to_dataids.clear();
-        m_clusterid_to_dataids.resize(num_clusters);
+        std::vector<std::uint32_t> &labels = m_labels.resetLabels(N, num_clusters);
         for (std::size_t shuffle_index = 0; shuffle_index < shuffle_indices.size(); ++shuffle_index)
         {
             std::size_t data_index = shuffle_indices.at(shuffle_index);
             std::size_t cluster_index = data_index % num_clusters;
-            m_clusterid_to_dataids[cluster_index].push_back(data_index);
+            labels[data_index] = static_cast<std::uint32_t>(cluster_index);
         }
+        const std::vector<std::size_t> &offsets(m_labels.getOffsets());
+        const std::vector<std::size_t> &members(m_labels.getMembers());
 
         
         // reset data
@@ -284,12 +438,12 @@ namespace scl
         // init
         for (std::size_t k = 0; k < num_clusters; ++k)
         {
-            double Nk(m_clusterid_to_dataids[k].size());
+            double Nk(offsets[k + 1] - offsets[k]);
             
             // calc mean
-            for (std::size_t j = 0; j < m_clusterid_to_dataids[k].size(); ++j)
+            for (std::size_t j = offsets[k]; j < offsets[k + 1]; ++j)
             {
-                std::size_t data_index = m_clusterid_to_dataids[k][j];
+                std::size_t data_index = members[j];
                 m_mean[k] += dataset.row(data_index).transpose();
             }
             m_mean[k] /= Nk;
@@ -298,110 +452,263 @@ namespace scl
             m_pi[k] = Nk / static_cast<double>(N);
 
             // calc covariance
-            for (std::size_t j = 0; j < m_clusterid_to_dataids[k].size(); ++j)
+            for (std::size_t j = offsets[k]; j < offsets[k + 1]; ++j)
             {
-                std::size_t data_index = m_clusterid_to_dataids[k][j];
+                std::size_t data_index = members[j];
                 Eigen::VectorXd err = dataset.row(data_index).transpose() - m_mean[k];
                 m_covariance[k] += err * err.transpose();
             }
             m_covariance[k] /= Nk;
         }
+        factorizeCovariances();
     }
 
 
-    void GaussianMixtureModel::expectationStep(const Eigen::MatrixXd &dataset)
+    void GaussianMixtureModel::expectationStep(const RowMatrix &dataset)
     {
         // set parameter
         const std::size_t num_clusters(m_num_clusters);
+        const std::size_t N(dataset.rows());
 
 
-        // for each data
-        for (std::size_t j = 0; j < dataset.rows(); ++j)
+        // for each data (gamma = exp(log(pi pdf) - log Σ pi pdf)) //
+        #pragma omp parallel
         {
-            double dominator(0.0);
-            for (std::size_t k = 0; k < num_clusters; ++k)
-            {
-                double pi_pdf = m_pi[k] * scl::normal::probabilityDensityFunction(dataset.row(j), m_mean[k], m_covariance[k]);
-                m_gamma[j][k] = pi_pdf;
-                dominator += pi_pdf;
-            }
-            for (std::size_t k = 0; k < num_clusters; ++k)
+            std::vector<double> log_scores(num_clusters, 0.0);
+            Eigen::VectorXd err(m_dim);
+
+            #pragma omp for schedule(static)
+            for (std::size_t j = 0; j < N; ++j)
             {
-                m_gamma[j][k] /= dominator;
+                const double log_sum = calcLogScores(dataset.row(j), log_scores, err);
+                for (std::size_t k = 0; k < num_clusters; ++k)
+                {
+                    // 全クラスタの確率が 0 なら等分する //
+                    m_gamma(j, k) = std::isfinite(log_sum) ? std::exp(log_scores[k] - log_sum) : 1.0 / static_cast<double>(num_clusters);
+                }
             }
         }
     }
 
     
-    void GaussianMixtureModel::maximizationStep(const Eigen::MatrixXd &dataset)
+    void GaussianMixtureModel::maximizationStep(const RowMatrix &dataset)
     {
         // set parameter
         const std::size_t dim(m_dim);
         const std::size_t num_clusters(m_num_clusters);
         const std::size_t N(dataset.rows());
-        
+        const double total_weight(totalWeight(N));
+        const std::size_t block_size(256);
+        const std::size_t num_blocks((N + block_size - 1) / block_size);
+
+
+        // ブロックごとの部分和をブロック順に足す (加算順序がスレッド数によらない) (重み付きなら負担率 x 重み) //
+        // Nk = Σ g, sums = Σ g d, scatters = Σ g d d^T  (d = x - 更新前の平均) //
+        // 部分和の領域が N に比例しないように、1回に num_slots ブロックずつ計算して足す //
+        const std::size_t num_slots(std::min(num_blocks, static_cast<std::size_t>(64)));
+        std::vector< std::vector<double> > block_nks(num_slots, std::vector<double>(num_clusters, 0.0));
+        std::vector< Eigen::MatrixXd, Eigen::aligned_allocator<Eigen::MatrixXd> > block_sums(num_slots, Eigen::MatrixXd::Zero(dim, num_clusters));
+        std::vector< std::vector< Eigen::MatrixXd, Eigen::aligned_allocator<Eigen::MatrixXd> > > block_scatters(num_slots);
+        std::vector<double> nks(num_clusters, 0.0);
+        Eigen::MatrixXd sums( Eigen::MatrixXd::Zero(dim, num_clusters) );
+        std::vector< Eigen::MatrixXd, Eigen::aligned_allocator<Eigen::MatrixXd> > scatters(num_clusters, Eigen::MatrixXd::Zero(dim, dim));
+        #pragma omp parallel
+        {
+            Eigen::MatrixXd errs(dim, block_size);
+            Eigen::VectorXd gammas(block_size);
+
+            for (std::size_t first_block = 0; first_block < num_blocks; first_block += num_slots)
+            {
+                const std::size_t num_round_blocks(std::min(num_slots, num_blocks - first_block));
+
+                #pragma omp for schedule(static)
+                for (std::size_t slot = 0; slot < num_round_blocks; ++slot)
+                {
+                    const std::size_t begin((first_block + slot) * block_size);
+                    const std::size_t rows(std::min(block_size, N - begin));
+                    block_scatters[slot].assign(num_clusters, Eigen::MatrixXd::Zero(dim, dim));
+                    for (std::size_t k = 0; k < num_clusters; ++k)
+                    {
+                        for (std::size_t row = 0; row < rows; ++row)
+                        {
+                            gammas(row) = sampleWeight(begin + row) * m_gamma(begin + row, k);
+                        }
+                        block_nks[slot][k] = gammas.head(rows).sum();
+
+                        // 1データ = 1列 (行優先の転置なので連続) //
+                        errs.leftCols(rows) = dataset.middleRows(begin, rows).transpose().colwise() - m_mean[k];
+                        block_sums[slot].col(k).noalias() = errs.leftCols(rows) * gammas.head(rows);
+
+                        // Σ g d d^T = (d √g)(d √g)^T //
+                        errs.leftCols(rows) = errs.leftCols(rows) * gammas.head(rows).cwiseSqrt().asDiagonal();
+                        block_scatters[slot][k].selfadjointView<Eigen::Lower>().rankUpdate(errs.leftCols(rows));
+                    }
+                }
+
+                // ブロック順に足す (omp for の後の暗黙のバリアで全ブロックが揃っている) //
+                #pragma omp single
+                {
+                    for (std::size_t slot = 0; slot < num_round_blocks; ++slot)
+                    {
+                        sums += block_sums[slot];
+                        for (std::size_t k = 0; k < num_clusters; ++k)
+                        {
+                            nks[k] += block_nks[slot][k];
+                            scatters[k] += block_scatters[slot][k];
+                        }
+                    }
+                }
+            }
+        }
+
 
         // for each cluster
         for (std::size_t k = 0; k < num_clusters; ++k)
         {
-            // calc Nk
-            double Nk(0.0);
-            for (std::size_t j = 0; j < N; ++j)
+            const double Nk(nks[k]);
+            const Eigen::VectorXd sum(sums.col(k));
+            Eigen::MatrixXd &scatter(scatters[k]);
+
+            // 負担するデータがなければ (負担率がすべて 0) 前回のパラメータのままにする //
+            if ( !(Nk > 0.0) )
             {
-                Nk += m_gamma[j][k];
+                continue;
             }
-            
-            
-            // calc mean
-            m_mean[k] = Eigen::VectorXd::Zero(dim);
-            for (std::size_t j = 0; j < N; ++j)
+            scatter.triangularView<Eigen::StrictlyUpper>() = scatter.transpose();
+
+            // calc mean (更新前の平均 + 差の平均)
+            const Eigen::VectorXd shift(sum / Nk);
+            m_mean[k] += shift;
+
+            // calc pi
+            m_pi[k] = Nk / total_weight;
+
+            // calc covariance (新しい平均まわり)
+            m_covariance[k] = scatter / Nk - shift * shift.transpose();
+        }
+
+        // 前回のままのクラスタがあっても混合比の和を1にする //
+        const double pi_sum( std::accumulate(m_pi.begin(), m_pi.end(), 0.0) );
+        if (pi_sum > 0.0)
+        {
+            for (std::size_t k = 0; k < num_clusters; ++k)
             {
-                m_mean[k] += m_gamma[j][k] * dataset.row(j).transpose();
+                m_pi[k] /= pi_sum;
             }
-            m_mean[k] /= Nk;
+        }
+        factorizeCovariances();
+    }
 
-            
-            // calc pi
-            m_pi[k] = Nk / static_cast<double>(N);
 
-            
-            // calc covariance
-            m_covariance[k] = Eigen::MatrixXd::Zero(dim, dim);
-            for (std::size_t j = 0; j < N; ++j)
+    void GaussianMixtureModel::factorizeCovariances()
+    {
+        const std::size_t dim(m_dim);
+        const std::size_t num_clusters(m_num_clusters);
+        const double log_two_pi( std::log(2.0 * M_PI) );
+        m_cholesky.resize(num_clusters);
+        m_log_coefficients.resize(num_clusters);
+
+        for (std::size_t k = 0; k < num_clusters; ++k)
+        {
+            Eigen::LLT<Eigen::MatrixXd> llt(m_covariance[k]);
+
+            // 正定値でなければ (データが縮退しているとき) 対角成分を少しずつ大きくする //
+            double ridge = 1.0e-9 * std::max(m_covariance[k].trace() / static_cast<double>(dim), 1.0e-12);
+            while ( llt.info() != Eigen::Success && std::isfinite(ridge) )
             {
-                Eigen::VectorXd err = dataset.row(j).transpose() - m_mean[k];
-                m_covariance[k] += m_gamma[j][k] * err * err.transpose();
+                m_covariance[k].diagonal().array() += ridge;
+                llt.compute(m_covariance[k]);
+                ridge *= 10.0;
             }
-            m_covariance[k] /= Nk;
+            m_cholesky[k] = llt.matrixL();
+
+            // log|Σ| = 2 Σ log(L_ii) //
+            const double log_determinant = 2.0 * m_cholesky[k].diagonal().array().log().sum();
+            m_log_coefficients[k] = std::log(m_pi[k]) - 0.5 * (static_cast<double>(dim) * log_two_pi + log_determinant);
         }
     }
 
 
+    template<class RowType>
+    double GaussianMixtureModel::calcLogScores(const RowType &point, std::vector<double> &log_scores, Eigen::VectorXd &err) const
+    {
+        const std::size_t num_clusters(m_num_clusters);
+        double max_log_score( -std::numeric_limits<double>::infinity() );
+        for (std::size_t k = 0; k < num_clusters; ++k)
+        {
+            // (x - mu)^T Σ^-1 (x - mu) = |L^-1 (x - mu)|^2 //
+            err = point.transpose() - m_mean[k];
+            m_cholesky[k].triangularView<Eigen::Lower>().solveInPlace(err);
+            log_scores[k] = m_log_coefficients[k] - 0.5 * err.squaredNorm();
+            max_log_score = std::max(max_log_score, log_scores[k]);
+        }
+        if ( !std::isfinite(max_log_score) )
+        {
+            return max_log_score;
+        }
+
+        // log-sum-exp
+        double sum(0.0);
+        for (std::size_t k = 0; k < num_clusters; ++k)
+        {
+            sum += std::exp(log_scores[k] - max_log_score);
+        }
+        return max_log_score + std::log(sum);
+    }
+
+
     double GaussianMixtureModel::calcBIC(const Eigen::MatrixXd &dataset)
+    {
+        return bayesianInformationCriterion(calcLogLikelihood(dataset), dataset.rows());
+    }
+
+
+    template<class Matrix>
+    double GaussianMixtureModel::calcLogLikelihood(const Matrix &dataset) const
     {
         // set parameter
-        const std::size_t dim(m_dim);
-        const std::size_t num_clusters(m_num_clusters);
         const std::size_t N(dataset.rows());
+        const std::size_t block_size(4096);
+        const std::size_t num_blocks((N + block_size - 1) / block_size);
 
 
-        double log_likelihood(0.0);
-        for (std::size_t j = 0; j < N; ++j)
+        // ブロックごとの部分和 //
+        std::vector<double> partial_sums(num_blocks, 0.0);
+        #pragma omp parallel
         {
-            double pdf(0.0);
-            for (std::size_t k = 0; k < num_clusters; ++k)
+            std::vector<double> log_scores(m_num_clusters, 0.0);
+            Eigen::VectorXd err(m_dim);
+
+            #pragma omp for schedule(static)
+            for (std::size_t block = 0; block < num_blocks; ++block)
             {
-                pdf += ( m_pi[k] * scl::normal::probabilityDensityFunction(dataset.row(j), m_mean[k], m_covariance[k]) );
+                const std::size_t end(std::min(N, (block + 1) * block_size));
+                double partial_sum(0.0);
+                for (std::size_t j = block * block_size; j < end; ++j)
+                {
+                    partial_sum += sampleWeight(j) * calcLogScores(dataset.row(j), log_scores, err);
+                }
+                partial_sums[block] = partial_sum;
             }
-            log_likelihood += std::log(pdf);
         }
 
-        
+        double log_likelihood(0.0);
+        for (std::size_t block = 0; block < num_blocks; ++block)
+        {
+            log_likelihood += partial_sums[block];
+        }
+        return log_likelihood;
+    }
+
+
+    double GaussianMixtureModel::bayesianInformationCriterion(const double log_likelihood, const std::size_t num_data) const
+    {
+        const std::size_t num_clusters(m_num_clusters);
         double p(m_dim);
         double q = p * (p + 1) * 0.5 * num_clusters;
         q += ( p * num_clusters );
         q += ( static_cast<double>(num_clusters) - 1.0);
-        double bic = -2.0 * log_likelihood + q * std::log( static_cast<double>(N) );
+        double bic = -2.0 * log_likelihood + q * std::log( totalWeight(num_data) );
         return bic;
     }
     
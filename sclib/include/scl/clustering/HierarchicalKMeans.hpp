@@ -0,0 +1,441 @@
+/**
+ * @file HierarchicalKMeans.hpp
+ * @brief This class implements the hierarchical k-means (vocabulary tree) clustering algorithm.
+ */
+
+#ifndef SCL_HIERARCHICAL_K_MEANS_HPP
+#define SCL_HIERARCHICAL_K_MEANS_HPP
+
+#include <scl/clustering/KMeans.hpp>
+#include <scl/util/Random.hpp>
+#include <scl/util/Parallel.hpp>
+#include <vector>
+#include <limits>
+#include <numeric>    // iota
+#include <algorithm>  // copy
+
+namespace scl
+{
+    /**
+     * @class HierarchicalKMeans
+     * @brief hierarchical k-means clustering (vocabulary tree).
+     * @details 各ノードのデータを branching 個に k-means で分割することを繰り返して木を作る。
+     * 葉がクラスタになり、最近傍の葉の探索は O(branching × depth) @n
+     * 参考 @n
+     * <a href="https://ieeexplore.ieee.org/document/1641018">Scalable Recognition with a Vocabulary Tree | D. Nister, H. Stewenius (2006)</a>
+     */
+    class HierarchicalKMeans
+    {
+    public:
+        /**
+         * @struct Node
+         * @brief 木のノード
+         */
+        struct Node
+        {
+            std::vector<double> centroid; /**< 重心位置 (ルートは空) */
+            std::size_t begin;            /**< HierarchicalKMeans::m_indices での範囲の先頭 */
+            std::size_t end;              /**< HierarchicalKMeans::m_indices での範囲の末尾 */
+            std::size_t first_child;      /**< 最初の子ノードのインデックス */
+            std::size_t num_children;     /**< 子ノードの数 (0なら葉) */
+            std::size_t leaf_id;          /**< 葉のクラスタID (葉でなければ std::numeric_limits<std::size_t>::max()) */
+        };
+
+
+        /** @brief コンストラクタ */
+        HierarchicalKMeans();
+
+
+        /**
+         * @brief 木のパラメータ設定
+         * @param[in] branching 各ノードの分割数
+         * @param[in] max_depth 木の最大の深さ (葉の数は最大 branching^max_depth)
+         */
+        void setParameters(const std::size_t branching, const std::size_t max_depth);
+
+
+        /**
+         * @brief 各ノードの k-means のパラメータ設定
+         * @param[in] method クラスタ重心の初期化方法 (KMeans::MANUAL は使えない)
+         * @see KMeans::setParameters
+         */
+        void setKMeansParameters(const std::size_t max_iteration, const double tolerance, const std::size_t max_pp_trial=3, const KMeans::InitMethod method=KMeans::PLUSPLUS);
+
+
+        /**
+         * @brief 乱数のシードを設定
+         * @details 各ノードのシードはノードのインデックスから決めるので、スレッド数によらず同じ木になる
+         */
+        void setSeed(const std::uint64_t seed);
+
+
+        /**
+         * @brief クラスタリング (木の構築)
+         * @tparam DataType クラスタリングするデータの型
+         * @param[in] dim DataTypeの次数
+         * @param[in] dataset クラスタリングするデータセット
+         * @details 同じ深さのノードは並列に分割する。各ノードの部分集合はコピーせずにインデックスで参照する
+         * @attention DataType needs [] access operator
+         */
+        template<class DataType>
+        void clustering(const std::size_t dim, const std::vector<DataType> &dataset);
+
+
+        /**
+         * @brief 最近傍の葉の取得
+         * @details ルートから各深さで最も近い子ノードをたどる。 O(branching × depth)
+         * @param[in] point 対象データ
+         * @return 葉のクラスタID
+         */
+        template<class DataType>
+        std::size_t predict(const DataType &point) const;
+
+
+        /** @brief 木の全ノード (0 がルート) */
+        const std::vector<Node> & getNodes() const;
+
+
+        /** @brief 葉の数 */
+        std::size_t getNumLeaves() const;
+
+
+        /**
+         * @brief 全クラスタ (葉) の情報取得
+         * @see HierarchicalKMeans::m_clusterid_to_dataids
+         */
+        const std::vector< std::vector<std::size_t> > & getClusters() const;
+
+
+        /**
+         * @brief 指定したクラスタ (葉) の情報取得
+         * @see HierarchicalKMeans::m_clusterid_to_dataids
+         */
+        const std::vector<std::size_t> & getCluster(const std::size_t cluster_id) const;
+
+
+    private:
+        /**
+         * @brief ノードの分割
+         * @details HierarchicalKMeans::m_indices のノードの範囲をそのまま k-means に渡し、その範囲の中で子ノード順に並べ替える。
+         * 子ノードへの振り分けは HierarchicalKMeans::predict と同じく最終的な重心で決める
+         * @param[in] kmeans 分割に使う k-means
+         * @param[in,out] partition_buffer 並べ替えの作業領域
+         * @param[out] children_centroids 子ノードの重心位置
+         * @param[out] children_ends 子ノードの範囲の末尾 (HierarchicalKMeans::m_indices での位置)
+         */
+        template<class DataType>
+        void splitNode(KMeans &kmeans, const std::vector<DataType> &dataset, const Node &node, std::vector<std::size_t> &partition_buffer,
+                       std::vector< std::vector<double> > &children_centroids, std::vector<std::size_t> &children_ends);
+
+
+        /** @brief データと重心の距離の2乗 */
+        template<class DataType>
+        double calcSquaredDistance(const DataType &point, const std::vector<double> &centroid) const;
+
+
+        /** @brief クラスタリングするデータの次数 */
+        std::size_t m_dim;
+
+
+        /** @brief 各ノードの分割数 */
+        std::size_t m_branching;
+
+
+        /** @brief 木の最大の深さ */
+        std::size_t m_max_depth;
+
+
+        /** @brief 木の全ノード */
+        std::vector<Node> m_nodes;
+
+
+        /** @brief データのインデックス (各ノードのデータは連続した範囲になるように並べ替える) */
+        std::vector<std::size_t> m_indices;
+
+
+        /** @brief 葉ごとのクラスタ情報 */
+        std::vector< std::vector<std::size_t> > m_clusterid_to_dataids;
+
+
+        /** @brief 各ノードの k-means の設定 */
+        KMeans m_kmeans;
+
+
+        /** @brief k-means の初期化方法 */
+        KMeans::InitMethod m_method;
+
+
+        /** @brief 乱数のシード */
+        std::uint64_t m_seed;
+
+    };  // end of hierarchical k-means class
+
+
+
+
+    //------------------------------------------------------------------
+    // 実装部
+    //------------------------------------------------------------------
+
+    HierarchicalKMeans::HierarchicalKMeans()
+        : m_dim(0),
+          m_branching(10),
+          m_max_depth(6),
+          m_method(KMeans::PLUSPLUS),
+          m_seed(scl::rng::randomSeed())
+    {
+    }
+
+
+    void HierarchicalKMeans::setParameters(const std::size_t branching, const std::size_t max_depth)
+    {
+        m_branching = branching;
+        m_max_depth = max_depth;
+    }
+
+
+    void HierarchicalKMeans::setKMeansParameters(const std::size_t max_iteration, const double tolerance, const std::size_t max_pp_trial, const KMeans::InitMethod method)
+    {
+        m_kmeans.setParameters(max_iteration, tolerance, max_pp_trial);
+        m_method = method;
+    }
+
+
+    void HierarchicalKMeans::setSeed(const std::uint64_t seed)
+    {
+        m_seed = seed;
+    }
+
+
+    template<class DataType>
+    void HierarchicalKMeans::clustering(const std::size_t dim, const std::vector<DataType> &dataset)
+    {
+        m_nodes.clear();
+        m_indices.clear();
+        m_clusterid_to_dataids.clear();
+
+        // size check
+        if (dim == 0 || dataset.empty() || m_branching < 2)
+        {
+            return;
+        }
+        m_dim = dim;
+
+
+        // root
+        m_indices.resize(dataset.size());
+        std::iota(m_indices.begin(), m_indices.end(), 0);
+        {
+            Node root;
+            root.begin = 0;
+            root.end = dataset.size();
+            root.first_child = 0;
+            root.num_children = 0;
+            root.leaf_id = std::numeric_limits<std::size_t>::max();
+            m_nodes.push_back(root);
+        }
+
+
+        // 深さごとに分割 //
+        std::size_t level_begin(0), level_end(1);
+        for (std::size_t depth = 0; depth < m_max_depth && level_begin < level_end; ++depth)
+        {
+            const std::size_t num_level_nodes(level_end - level_begin);
+            std::vector< std::vector< std::vector<double> > > children_centroids(num_level_nodes);
+            std::vector< std::vector<std::size_t> > children_ends(num_level_nodes);
+
+            // ノード数がスレッド数より少ないときは k-means の中で並列化する //
+            // (各ノードは m_indices の自分の範囲だけを並べ替える) //
+            const bool is_parallel_nodes(num_level_nodes >= scl::parallel::maxThreads());
+            #pragma omp parallel if(is_parallel_nodes)
+            {
+                std::vector<std::size_t> partition_buffer;
+
+                #pragma omp for schedule(dynamic)
+                for (std::size_t level_index = 0; level_index < num_level_nodes; ++level_index)
+                {
+                    const std::size_t node_index(level_begin + level_index);
+                    KMeans kmeans(m_kmeans);
+                    kmeans.setSeed(scl::rng::streamSeed(m_seed, node_index));
+                    splitNode(kmeans, dataset, m_nodes[node_index], partition_buffer, children_centroids[level_index], children_ends[level_index]);
+                }
+            }
+
+            // 子ノードの追加 (ノード順に並べるので結果はスレッド数によらない) //
+            for (std::size_t level_index = 0; level_index < num_level_nodes; ++level_index)
+            {
+                const std::size_t node_index(level_begin + level_index);
+                std::size_t offset(m_nodes[node_index].begin);
+                m_nodes[node_index].first_child = m_nodes.size();
+                m_nodes[node_index].num_children = children_ends[level_index].size();
+                for (std::size_t child_index = 0; child_index < children_ends[level_index].size(); ++child_index)
+                {
+                    Node child;
+                    child.centroid.swap(children_centroids[level_index][child_index]);
+                    child.begin = offset;
+                    child.end = children_ends[level_index][child_index];
+                    child.first_child = 0;
+                    child.num_children = 0;
+                    child.leaf_id = std::numeric_limits<std::size_t>::max();
+                    m_nodes.push_back(child);
+                    offset = child.end;
+                }
+            }
+
+            level_begin = level_end;
+            level_end = m_nodes.size();
+        }
+
+
+        // 葉のクラスタ情報 //
+        for (std::size_t node_index = 0; node_index < m_nodes.size(); ++node_index)
+        {
+            Node &node(m_nodes[node_index]);
+            if (node.num_children == 0)
+            {
+                node.leaf_id = m_clusterid_to_dataids.size();
+                m_clusterid_to_dataids.push_back(std::vector<std::size_t>(m_indices.begin() + node.begin, m_indices.begin() + node.end));
+            }
+        }
+    }
+
+
+    template<class DataType>
+    void HierarchicalKMeans::splitNode(KMeans &kmeans, const std::vector<DataType> &dataset, const Node &node, std::vector<std::size_t> &partition_buffer,
+                                       std::vector< std::vector<double> > &children_centroids, std::vector<std::size_t> &children_ends)
+    {
+        // データ数が分割数以下なら葉 //
+        const std::size_t num_data(node.end - node.begin);
+        if (num_data <= m_branching)
+        {
+            return;
+        }
+
+        std::vector< std::vector<double> > centroids;
+        kmeans.clustering(m_dim, dataset, m_indices, node.begin, node.end, m_branching, centroids, m_method);
+
+        // k-means の最後のラベルは更新前の重心で決まるので、 predict と同じ最終的な重心で割り当て直す //
+        std::vector<std::size_t> labels(num_data, 0);
+        std::vector<std::size_t> offsets(centroids.size() + 1, 0);
+        for (std::size_t member_index = 0; member_index < num_data; ++member_index)
+        {
+            const DataType &point(dataset[m_indices[node.begin + member_index]]);
+            double min_squared_distance(std::numeric_limits<double>::max());
+            for (std::size_t cluster_index = 0; cluster_index < centroids.size(); ++cluster_index)
+            {
+                const double squared_distance(calcSquaredDistance(point, centroids[cluster_index]));
+                if (squared_distance < min_squared_distance)
+                {
+                    min_squared_distance = squared_distance;
+                    labels[member_index] = cluster_index;
+                }
+            }
+            ++offsets[labels[member_index] + 1];
+        }
+
+        // 空のクラスタは子ノードにしない //
+        std::size_t num_children(0);
+        for (std::size_t cluster_index = 0; cluster_index < centroids.size(); ++cluster_index)
+        {
+            if (offsets[cluster_index + 1] > 0)
+            {
+                ++num_children;
+            }
+            offsets[cluster_index + 1] += offsets[cluster_index];
+        }
+
+        // 分割できなかった //
+        if (num_children < 2)
+        {
+            return;
+        }
+
+        // ノードの範囲をクラスタ順に並べ替える (クラスタ内はデータ順) //
+        std::vector<std::size_t> positions(offsets.begin(), offsets.end() - 1);
+        partition_buffer.resize(num_data);
+        for (std::size_t member_index = 0; member_index < num_data; ++member_index)
+        {
+            partition_buffer[positions[labels[member_index]]++] = m_indices[node.begin + member_index];
+        }
+        std::copy(partition_buffer.begin(), partition_buffer.end(), m_indices.begin() + node.begin);
+
+        for (std::size_t cluster_index = 0; cluster_index < centroids.size(); ++cluster_index)
+        {
+            if (offsets[cluster_index] < offsets[cluster_index + 1])
+            {
+                children_centroids.push_back(centroids[cluster_index]);
+                children_ends.push_back(node.begin + offsets[cluster_index + 1]);
+            }
+        }
+    }
+
+
+    template<class DataType>
+    double HierarchicalKMeans::calcSquaredDistance(const DataType &point, const std::vector<double> &centroid) const
+    {
+        double squared_distance(0.0);
+        for (std::size_t value_index = 0; value_index < m_dim; ++value_index)
+        {
+            const double error = static_cast<double>(point[value_index]) - centroid[value_index];
+            squared_distance += error * error;
+        }
+        return squared_distance;
+    }
+
+
+    template<class DataType>
+    std::size_t HierarchicalKMeans::predict(const DataType &point) const
+    {
+        if (m_nodes.empty())
+        {
+            return 0;
+        }
+
+        std::size_t node_index(0);
+        while (m_nodes[node_index].num_children > 0)
+        {
+            const Node &node(m_nodes[node_index]);
+            std::size_t nearest_index(node.first_child);
+            double min_squared_distance(std::numeric_limits<double>::max());
+            for (std::size_t child_index = node.first_child; child_index < node.first_child + node.num_children; ++child_index)
+            {
+                const double squared_distance(calcSquaredDistance(point, m_nodes[child_index].centroid));
+                if (squared_distance < min_squared_distance)
+                {
+                    min_squared_distance = squared_distance;
+                    nearest_index = child_index;
+                }
+            }
+            node_index = nearest_index;
+        }
+        return m_nodes[node_index].leaf_id;
+    }
+
+
+    const std::vector<HierarchicalKMeans::Node>& HierarchicalKMeans::getNodes() const
+    {
+        return m_nodes;
+    }
+
+
+    std::size_t HierarchicalKMeans::getNumLeaves() const
+    {
+        return m_clusterid_to_dataids.size();
+    }
+
+
+    const std::vector< std::vector<std::size_t> >& HierarchicalKMeans::getClusters() const
+    {
+        return m_clusterid_to_dataids;
+    }
+
+
+    const std::vector<std::size_t>& HierarchicalKMeans::getCluster(const std::size_t cluster_id) const
+    {
+        return m_clusterid_to_dataids.at(cluster_id);
+    }
+
+} // end of namespace scl
+
+
+#endif  /* SCL_HIERARCHICAL_K_MEANS_HPP */
@@ -6,17 +6,278 @@
 #ifndef SCL_K_MEANS_HPP
 #define SCL_K_MEANS_HPP
 
+#include <scl/clustering/ClusterLabels.hpp>
+#include <scl/tree/KdTree.hpp>
+#include <scl/util/Random.hpp>
+#include <scl/util/Parallel.hpp>
+#include <Eigen/Core>
 #include <vector>
 #include <numeric>    // iota
 #include <algorithm>  // shuffle
 #include <random>     // random
 #include <limits>     // limit
+#include <cmath>      // sqrt
+#include <cstdint>    // uint64_t, int32_t
+#include <type_traits> // conditional
+#include <utility>    // declval
+#include <stdexcept>  // out_of_range
 
 #include <cassert>    // assert
 #include <iostream>   // debug
 
 namespace scl
 {
+    namespace internal {
+        /** @brief DataType の要素の型 */
+        template<class DataType>
+        struct ElementType
+        {
+            typedef typename std::decay<decltype(std::declval<const DataType&>()[0])>::type type;
+        };
+
+
+        /** @brief 8bit 整数か */
+        template<class ValueType>
+        struct IsSmallInteger
+        {
+            static const bool value = ( std::is_integral<ValueType>::value && sizeof(ValueType) == 1 );
+        };
+
+
+        /** @brief float で計算できる型か (float or 8bit 整数) */
+        template<class ValueType>
+        struct IsSinglePrecision
+        {
+            static const bool value = ( std::is_same<ValueType, float>::value || IsSmallInteger<ValueType>::value );
+        };
+
+
+        /**
+         * @brief 距離の2乗を計算する型
+         * @details 8bit 整数同士は int32 (SSD)、float と 8bit 整数の組み合わせは float、それ以外は double
+         */
+        template<class DataTypeA, class DataTypeB>
+        struct SquaredDistanceType
+        {
+            typedef typename ElementType<DataTypeA>::type value_type_a;
+            typedef typename ElementType<DataTypeB>::type value_type_b;
+
+            typedef typename std::conditional< IsSmallInteger<value_type_a>::value && IsSmallInteger<value_type_b>::value,
+                                               std::int32_t,
+                                               typename std::conditional< IsSinglePrecision<value_type_a>::value && IsSinglePrecision<value_type_b>::value,
+                                                                          float,
+                                                                          double >::type >::type type;
+        };
+
+
+        /**
+         * @brief ラベル更新時にクラスタ重心を持つ型
+         * @details データが float or 8bit 整数なら float、それ以外は double
+         */
+        template<class DataType>
+        struct CentroidValueType
+        {
+            typedef typename std::conditional< IsSinglePrecision<typename ElementType<DataType>::type>::value, float, double >::type type;
+        };
+
+
+        /**
+         * @brief データセットの一部をコピーせずに参照する
+         * @details i 番目の要素は dataset[indices[i]]
+         */
+        template<class DataType>
+        class IndexedDataset
+        {
+        public:
+            typedef DataType value_type;
+
+            IndexedDataset(const std::vector<DataType> &dataset, const std::vector<std::size_t> &indices)
+                : m_dataset(&dataset), m_indices(indices.empty() ? NULL : &indices[0]), m_size(indices.size())
+            {
+            }
+
+            /** @brief indices[0] ... indices[size-1] を参照する */
+            IndexedDataset(const std::vector<DataType> &dataset, const std::size_t *indices, const std::size_t size)
+                : m_dataset(&dataset), m_indices(indices), m_size(size)
+            {
+            }
+
+            std::size_t size() const { return m_size; }
+            bool empty() const { return m_size == 0; }
+            const DataType & operator[](const std::size_t index) const { return (*m_dataset)[m_indices[index]]; }
+            const DataType & at(const std::size_t index) const
+            {
+                if (index >= m_size)
+                {
+                    throw std::out_of_range("IndexedDataset::at");
+                }
+                return m_dataset->at(m_indices[index]);
+            }
+
+        private:
+            const std::vector<DataType> *m_dataset;
+            const std::size_t *m_indices;
+            std::size_t m_size;
+        };
+
+        /**
+         * @brief ラベルごとの重み付きの和 (クラスタ内はデータ順に足す)
+         * @details KMeans と FixedKMeans の重心計算で共通
+         * @param[in] dim データの次数
+         * @param[in] dataset データセット
+         * @param[in] labels 各データのクラスタID
+         * @param[in] weight_of データのインデックスから和に掛ける重み
+         * @param[out] centroids 各クラスタの重み付きの和 (サイズはクラスタ数にしておく)
+         * @param[out] weight_sums 各クラスタの重みの和
+         */
+        template<class Dataset, class Centroids, class WeightFunction>
+        void sumCentroids(const std::size_t dim, const Dataset &dataset, const std::vector<std::uint32_t> &labels, const WeightFunction &weight_of,
+                          Centroids &centroids, std::vector<double> &weight_sums)
+        {
+            const std::size_t num_clusters(centroids.size());
+            weight_sums.assign(num_clusters, 0.0);
+            for (std::size_t cluster_index = 0; cluster_index < num_clusters; ++cluster_index)
+            {
+                std::fill(centroids[cluster_index].begin(), centroids[cluster_index].end(), 0.0);
+            }
+
+            for (std::size_t data_index = 0; data_index < labels.size(); ++data_index)
+            {
+                const std::size_t cluster_index(labels[data_index]);
+                const double weight(weight_of(data_index));
+                for (std::size_t value_index = 0; value_index < dim; ++value_index)
+                {
+                    centroids[cluster_index][value_index] += weight * static_cast<double>(dataset[data_index][value_index]);
+                }
+                weight_sums[cluster_index] += weight;
+            }
+        }
+
+
+        /**
+         * @brief 重み付きの和を平均にする (データのないクラスタは 0 のまま)
+         * @see internal::sumCentroids
+         */
+        template<class Centroids>
+        void averageCentroids(const std::size_t dim, const std::vector<double> &weight_sums, Centroids &centroids)
+        {
+            for (std::size_t cluster_index = 0; cluster_index < centroids.size(); ++cluster_index)
+            {
+                if (weight_sums[cluster_index] > 0.0)
+                {
+                    for (std::size_t value_index = 0; value_index < dim; ++value_index)
+                    {
+                        centroids[cluster_index][value_index] /= weight_sums[cluster_index];
+                    }
+                }
+            }
+        }
+
+
+        /**
+         * @brief 空のクラスタの再設定
+         * @details 誤差の2乗和が最大のクラスタ (データ2つ以上) から重心に最も遠いデータを移し、空のクラスタの重心にする。
+         * KMeans と FixedKMeans で共通
+         * @param[in] dim データの次数
+         * @param[in] dataset データセット
+         * @param[in] weight_of データのインデックスから重み
+         * @param[in] distance_of データのインデックスと重心から距離 (の2乗)
+         * @param[in] scales 新しい重心にするときのデータの倍率 (NULL なら 1)。
+         * 倍率を使うとき (正規化した重心) は和に戻せないので分割元の重心は更新しない
+         * @param[in,out] labels 各データのクラスタID (移したデータは空のクラスタへ)
+         * @param[in,out] centroids 各クラスタの重心位置
+         * @return 再設定したクラスタ数
+         */
+        template<class Dataset, class Centroids, class WeightFunction, class DistanceFunction>
+        std::size_t reseedEmptyClusters(const std::size_t dim, const Dataset &dataset, const WeightFunction &weight_of, const DistanceFunction &distance_of,
+                                        const std::vector<double> *scales, std::vector<std::uint32_t> &labels, Centroids &centroids)
+        {
+            // count
+            const std::size_t num_clusters(centroids.size());
+            const std::size_t num_data(labels.size());
+            std::vector<std::size_t> counts(num_clusters, 0);
+            for (std::size_t data_index = 0; data_index < num_data; ++data_index)
+            {
+                ++counts[labels[data_index]];
+            }
+            if (std::find(counts.begin(), counts.end(), 0) == counts.end())
+            {
+                return 0;
+            }
+
+            // 各データの誤差と各クラスタの誤差の2乗和 //
+            std::vector<double> distance_list(num_data);
+            std::vector<double> cluster_costs(num_clusters, 0.0);
+            std::vector<double> cluster_weights(num_clusters, 0.0);
+            for (std::size_t data_index = 0; data_index < num_data; ++data_index)
+            {
+                const double weight(weight_of(data_index));
+                distance_list[data_index] = weight * distance_of(data_index, centroids[labels[data_index]]);
+                cluster_costs[labels[data_index]] += distance_list[data_index];
+                cluster_weights[labels[data_index]] += weight;
+            }
+
+            std::size_t num_reseeded(0);
+            for (std::size_t empty_index = 0; empty_index < num_clusters; ++empty_index)
+            {
+                if (counts[empty_index] > 0)
+                {
+                    continue;
+                }
+
+                // 誤差の2乗和が最大のクラスタ (データ2つ以上) //
+                std::size_t donor_index(num_clusters);
+                for (std::size_t cluster_index = 0; cluster_index < num_clusters; ++cluster_index)
+                {
+                    if (counts[cluster_index] > 1 && (donor_index == num_clusters || cluster_costs[cluster_index] > cluster_costs[donor_index]))
+                    {
+                        donor_index = cluster_index;
+                    }
+                }
+                if (donor_index == num_clusters)
+                {
+                    break;
+                }
+
+                // 重心から最も遠いデータ //
+                std::size_t farthest_index(num_data);
+                for (std::size_t data_index = 0; data_index < num_data; ++data_index)
+                {
+                    if (labels[data_index] == donor_index && (farthest_index == num_data || distance_list[data_index] > distance_list[farthest_index]))
+                    {
+                        farthest_index = data_index;
+                    }
+                }
+
+                // move : 分割元の重心からデータを除いて、空のクラスタの重心にする //
+                const double weight(weight_of(farthest_index));
+                const double donor_weight(cluster_weights[donor_index]);
+                const double scale = (scales == NULL) ? 1.0 : (*scales)[farthest_index];
+                for (std::size_t value_index = 0; value_index < dim; ++value_index)
+                {
+                    const double value = static_cast<double>(dataset[farthest_index][value_index]);
+                    if (scales == NULL && donor_weight > weight)
+                    {
+                        centroids[donor_index][value_index] = (donor_weight * centroids[donor_index][value_index] - weight * value) / (donor_weight - weight);
+                    }
+                    centroids[empty_index][value_index] = scale * value;
+                }
+                labels[farthest_index] = static_cast<std::uint32_t>(empty_index);
+                --counts[donor_index];
+                counts[empty_index] = 1;
+                cluster_weights[donor_index] -= weight;
+                cluster_weights[empty_index] = weight;
+                cluster_costs[donor_index] -= distance_list[farthest_index];
+                cluster_costs[empty_index] = 0.0;
+                distance_list[farthest_index] = 0.0;
+                ++num_reseeded;
+            }
+            return num_reseeded;
+        }
+        
+    } // end namespace internal
+
+
     /** 
      * @class KMeans
      * @brief k-means clustering.
@@ -37,12 +298,57 @@ namespace scl
             RANDOM,   /**< ランダムにクラスタリングして重心計算 */
             UNIFORM,  /**< 頭から順番にクラスタリングして重心計算 */
             PLUSPLUS, /**< k-means++ */
-            MANUAL    /**< ユーザの入力をそのまま使う */
+            MANUAL,   /**< ユーザの入力をそのまま使う */
+            SCALABLE  /**< k-means|| (scalable k-means++) */
+        };
+
+
+        /**
+         * @enum LabelMethod
+         * @brief ラベル更新 (最近傍クラスタ探索) の方法
+         */
+        enum LabelMethod
+        {
+            AUTO,         /**< 次数とクラスタ数から自動で選ぶ (低次元なら FILTERING、高次元なら GEMM) */
+            BRUTE_FORCE,  /**< 全クラスタ重心との距離を計算 */
+            KD_TREE,      /**< クラスタ重心の kd-tree を毎回作って最近傍探索 */
+            FILTERING,    /**< データの kd-tree を1回だけ作り、ノードごとに候補重心を枝刈り (Kanungo et al.) */
+            GEMM          /**< ||x||^2 - 2 x・c + ||c||^2 の x・c をタイルごとの行列積 (Eigen) で計算 */
+        };
+
+
+        /**
+         * @enum DistanceType
+         * @brief データとクラスタ重心の距離
+         */
+        enum DistanceType
+        {
+            EUCLIDEAN,  /**< ユークリッド距離の2乗 */
+            COSINE      /**< コサイン距離 1 - cos (spherical k-means、重心は単位ベクトル) */
+        };
+
+
+        /**
+         * @struct Result
+         * @brief クラスタリング結果の情報
+         */
+        struct Result
+        {
+            double inertia;              /**< 各データと所属クラスタ重心との距離の2乗の総和 */
+            std::size_t num_iterations;  /**< 反復回数 */
+            bool is_converged;           /**< 収束したか */
         };
 
 
         /** @brief コンストラクタ */
         KMeans();
+
+
+        /**
+         * @brief 乱数のシードを指定するコンストラクタ
+         * @details std::random_device を使わずに KMeans::setSeed と同じ初期化をする
+         */
+        explicit KMeans(const std::uint64_t seed);
         
         
         /** @brief デストラクタ */
@@ -58,6 +364,51 @@ namespace scl
         void setParameters(const std::size_t max_iteration, const double tolerance, const std::size_t max_pp_trial=3);
 
 
+        /**
+         * @brief k-means|| で初期化するときのパラメータ設定
+         * @param[in] oversampling_factor 1ラウンドで選ぶ候補数の期待値 (クラスタ数に対する倍率)
+         * @param[in] num_rounds サンプリングのラウンド数
+         */
+        void setScalableParameters(const double oversampling_factor, const std::size_t num_rounds);
+
+
+        /** @brief ラベル更新 (最近傍クラスタ探索) の方法を設定 */
+        void setLabelMethod(const LabelMethod label_method);
+
+
+        /**
+         * @brief 距離の設定
+         * @param[in] distance_type 距離 (デフォルトは KMeans::EUCLIDEAN)
+         * @details KMeans::COSINE ではデータを正規化したものとしてクラスタリングする (spherical k-means)。
+         * データはコピーせず各データのノルムだけを持ち、ラベル更新は常に行列積の argmax (KMeans::GEMM) で行う。
+         * 重心は単位ベクトル、Result::inertia は重み付きの 1 - cos の総和になる
+         */
+        void setDistanceType(const DistanceType distance_type);
+
+
+        /**
+         * @brief 初期化を変えてクラスタリングする回数を設定 (デフォルト 1)
+         * @details 各回は並列に実行し、KMeans::Result::inertia が最小の結果を使う @n
+         * 初期化方法が KMeans::MANUAL の場合は1回だけ
+         */
+        void setNumInit(const std::size_t num_init);
+
+
+        /**
+         * @brief 乱数のシードを設定
+         * @details 同じシードなら初期化の結果も同じになる (並列実行時もスレッド数によらない) @n
+         * 設定しない場合はコンストラクタで std::random_device から1回だけ初期化する
+         */
+        void setSeed(const std::uint64_t seed);
+
+
+        /**
+         * @brief 乱数器を設定
+         * @see KMeans::setSeed
+         */
+        void setRandomEngine(const std::mt19937 &engine);
+
+
         /**
          * @brief クラスタリング
          * @tparam DataType クラスタリングするデータの型
@@ -81,104 +432,460 @@ namespace scl
         bool clustering(const std::size_t dim, const std::vector<DataType> &dataset, const std::size_t num_clusters, const InitMethod method=PLUSPLUS);
 
 
+        /**
+         * @brief データセットの一部だけをクラスタリング
+         * @details 部分集合はコピーせずに参照する。
+         * クラスタの情報 ( KMeans::getClusters ) には dataset でのインデックスが入る
+         * @param[in] indices クラスタリングするデータの dataset でのインデックス
+         * @see KMeans::clustering
+         */
+        template<class DataType>
+        bool clustering(const std::size_t dim, const std::vector<DataType> &dataset, const std::vector<std::size_t> &indices,
+                        const std::size_t num_clusters, std::vector< std::vector<double> > &centroids, const InitMethod method=PLUSPLUS);
+
+
+        /**
+         * @brief データセットの一部 (indices[begin] ... indices[end-1]) だけをクラスタリング
+         * @details データもインデックスもコピーしない (階層的 k-means の分割や X-means の再帰分割など、同じ並べ替え配列を使い回すとき用)。
+         * ラベル ( KMeans::getLabels ) は範囲内の位置 (0 ... end-begin-1) の順で、
+         * クラスタの情報 ( KMeans::getClusters ) にも範囲内の位置が入る
+         * @param[in] indices クラスタリングするデータの dataset でのインデックス
+         * @param[in] begin 範囲の先頭
+         * @param[in] end 範囲の末尾の次
+         * @see KMeans::clustering
+         */
+        template<class DataType>
+        bool clustering(const std::size_t dim, const std::vector<DataType> &dataset, const std::vector<std::size_t> &indices, const std::size_t begin, const std::size_t end,
+                        const std::size_t num_clusters, std::vector< std::vector<double> > &centroids, const InitMethod method=PLUSPLUS);
+
+
+        /**
+         * @brief データセットの一部だけを重み付きでクラスタリング
+         * @param[in] weights 範囲内の各データの重み (サイズ end-begin 、正の値)
+         * @see KMeans::clustering
+         */
+        template<class DataType>
+        bool clustering(const std::size_t dim, const std::vector<DataType> &dataset, const std::vector<std::size_t> &indices, const std::size_t begin, const std::size_t end,
+                        const std::vector<double> &weights, const std::size_t num_clusters, std::vector< std::vector<double> > &centroids, const InitMethod method=PLUSPLUS);
+
+
+        /**
+         * @brief 重み付きデータのクラスタリング
+         * @details 重み w のデータは w 個の同じデータとして扱う (重複をまとめたデータや coreset をそのまま使える)。
+         * 評価値 ( KMeans::Result::inertia ) も重み付き。 KMeans::FILTERING は使えないので KMeans::KD_TREE になる
+         * @param[in] weights 各データの重み (dataset と同じサイズ、正の値)
+         * @see KMeans::clustering
+         */
+        template<class DataType>
+        bool clustering(const std::size_t dim, const std::vector<DataType> &dataset, const std::vector<double> &weights,
+                        const std::size_t num_clusters, std::vector< std::vector<double> > &centroids, const InitMethod method=PLUSPLUS);
+
+
+        /**
+         * @brief クラスタ重心の初期化だけを行う
+         * @details k-means++ などの結果だけを使うとき (coreset の作成など) に使う
+         * @param[in] method クラスタ重心の初期化方法 (KMeans::MANUAL は何もしない)
+         * @see KMeans::clustering
+         */
+        template<class DataType>
+        void initCentroids(const std::size_t dim, const std::vector<DataType> &dataset, const std::size_t num_clusters, std::vector< std::vector<double> > &centroids, const InitMethod method=PLUSPLUS);
+
+
+        /**
+         * @brief 重み付きデータのクラスタ重心の初期化だけを行う
+         * @param[in] weights 各データの重み (dataset と同じサイズ、正の値)
+         * @see KMeans::initCentroids
+         */
+        template<class DataType>
+        void initCentroids(const std::size_t dim, const std::vector<DataType> &dataset, const std::vector<double> &weights,
+                           const std::size_t num_clusters, std::vector< std::vector<double> > &centroids, const InitMethod method=PLUSPLUS);
+
+
+        /**
+         * @brief 重みに比例した確率でインデックスを選ぶ
+         * @param[in] weights 各インデックスの重み
+         * @param[in] thresholds [0, 重みの総和) の閾値 (昇順)
+         * @param[out] indices 各閾値に対応するインデックス (thresholds と同じサイズ)
+         * @return 重みが正のインデックスがあるか
+         */
+        static bool sampleIndices(const std::vector<double> &weights, const std::vector<double> &thresholds, std::vector<std::size_t> &indices);
+
+
         /** 
          * @brief 全クラスタの情報取得
-         * @see KMeans::m_clusterid_to_dataids
+         * @details 最初の呼び出しでラベル配列から作る
+         * @see ClusterLabels::getClusters
          */
         const std::vector< std::vector<std::size_t> > & getClusters() const;
 
 
         /**
          * @brief 指定したクラスタの情報取得
-         * @see KMeans::m_clusterid_to_dataids
+         * @see ClusterLabels::getCluster
          */
         const std::vector<std::size_t> & getCluster(const std::size_t cluster_id) const;
 
+
+        /**
+         * @brief 各データのクラスタID
+         * @details 部分集合をクラスタリングした場合は indices の順
+         */
+        const std::vector<std::uint32_t> & getLabels() const;
+
+
+        /**
+         * @brief クラスタリング結果 (ラベル配列と CSR 形式のクラスタごとのデータ)
+         * @see ClusterLabels
+         */
+        const ClusterLabels & getClusterLabels() const;
+
+
+        /**
+         * @brief 直前のクラスタリング結果の情報取得
+         * @see KMeans::Result
+         */
+        const Result & getResult() const;
+
         
         /**
          * @brief 距離の2乗
+         * @details 要素の型に合わせた精度で計算する (8bit 整数同士は int32、float は float、それ以外は double)
          * @return ||point_a - point_b||^2
+         * @see internal::SquaredDistanceType
          */
         template<class DataTypeA, class DataTypeB>
-        double calcSquaredDistance(const DataTypeA &point_a, const DataTypeB &point_b);
+        double calcSquaredDistance(const DataTypeA &point_a, const DataTypeB &point_b) const;
 
         
     protected: 
         /**
-         * @brief 乱数によるクラスタ重心の初期化
-         * @tparam DataType クラスタリングするデータの型
-         * @param[in] dataset クラスタリングするデータセット
-         * @param[in] num_clusters クラスタ数
-         * @param[out] centroids 各クラスタの重心位置
+         * @brief クラスタリングの本体
+         * @tparam Dataset std::vector<DataType> or internal::IndexedDataset<DataType>
+         * @see KMeans::clustering
          */
-        template<class DataType>
-        void initCentroidsRandom(const std::vector<DataType> &dataset, const std::size_t num_clusters, std::vector< std::vector<double> > &centroids);
+        template<class Dataset>
+        bool clusteringDataset(const std::size_t dim, const Dataset &dataset, const std::size_t num_clusters, std::vector< std::vector<double> > &centroids, const InitMethod method);
 
 
         /**
-         * @brief 頭から順番にクラスタリングして重心初期化
-         * @see Kmeans::initCentroidsRandom
+         * @brief クラスタ重心の初期化
+         * @return KMeans::MANUAL で centroids の数が num_clusters と違えば false
          */
-        template<class DataType>
-        void initCentroidsUniform(const std::vector<DataType> &dataset, const std::size_t num_clusters, std::vector< std::vector<double> > &centroids);
+        template<class Dataset>
+        bool initCentroidsDataset(const Dataset &dataset, const std::size_t num_clusters, std::vector< std::vector<double> > &centroids, const InitMethod method);
 
 
         /**
-         * @brief k-means++によるクラスタ重心の初期化
-         * @see Kmeans::initCentroidsRandom
+         * @brief クラスタリングのパラメータだけをコピー (ラベルや kd-tree などの結果は空のまま)
+         * @param[in] other コピー元
          */
-        template<class DataType>
-        void initCentroidsPlusplus(const std::vector<DataType> &dataset, const std::size_t num_clusters, std::vector< std::vector<double> > &centroids);
+        void copyParameters(const KMeans &other);
 
 
         /**
-         * @brief ラベルの更新
-         * @tparam DataType クラスタリングするデータの型
-         * @param[in] dataset クラスタリングするデータセット
-         * @param[out] centroids 各クラスタの重心位置
-         * @return 評価値
+         * @brief 初期化を変えて複数回クラスタリングし、最も評価値の良い結果を使う
+         * @see KMeans::clustering
+         * @see KMeans::setNumInit
          */
-        template<class DataType>
-        double updateLabel(const std::vector<DataType> &dataset, const std::vector< std::vector<double> > &centroids);
-    
+        template<class Dataset>
+        bool clusteringRestarts(const std::size_t dim, const Dataset &dataset, const std::size_t num_clusters, std::vector< std::vector<double> > &centroids, const InitMethod method);
+
 
         /**
-         * @brief クラスタ重心の計算
-         * @tparam DataType クラスタリングするデータの型
-         * @param[in] dataset クラスタリングするデータセット
-         * @param[out] centroids 各クラスタの重心位置
-         * @attention m_clusterid_to_dataids が必要
+         * @brief KMeans::COSINE 用に各データのノルムの逆数を計算
+         * @details KMeans::EUCLIDEAN なら何もしない。ノルムが 0 のデータは 0 にする
          */
-        template<class DataType>
-        void calcCentroids(const std::vector<DataType> &dataset, std::vector< std::vector<double> > &centroids);
-        
-        
+        template<class Dataset>
+        void calcInverseNorms(const Dataset &dataset);
+
+
         /**
-         * @brief クラスタID(=index)ごとにデータIDを割り振った配列
-         * @par example
-         * data_indices = this[cluster_index] @n
-         * data_index = this[cluster_index][array_index]
+         * @brief データ同士の距離 (KMeans::DistanceType による)
+         * @param[in] data_index_a, data_index_b データのインデックス
          */
-        std::vector< std::vector<std::size_t> > m_clusterid_to_dataids;
-
-    
-        /** @brief 最大試行回数 */
-        std::size_t m_max_iteration;
+        template<class Dataset>
+        double calcDataDistance(const Dataset &dataset, const std::size_t data_index_a, const std::size_t data_index_b) const;
 
-    
-        /** @brief 収束判定閾値 */
-        double m_tolerance;
 
+        /**
+         * @brief データとクラスタ重心の距離 (KMeans::DistanceType による)
+         * @param[in] data_index データのインデックス
+         * @param[in] centroid クラスタ重心 (KMeans::COSINE なら単位ベクトル)
+         */
+        template<class Dataset>
+        double calcCentroidDistance(const Dataset &dataset, const std::size_t data_index, const std::vector<double> &centroid) const;
 
-        /** @brief k-means++で初期化するときの最大試行回数 */
-        std::size_t m_max_pp_trial;
 
+        /**
+         * @brief 内積
+         */
+        template<class DataTypeA, class DataTypeB>
+        double calcDotProduct(const DataTypeA &point_a, const DataTypeB &point_b) const;
 
-        /** @brief クラスタリングするデータの次数 */
-        std::size_t m_dim;
-        
-        
-    };  // end of k-means class
+
+        /**
+         * @brief KMeans::COSINE ならクラスタ重心を単位ベクトルにする
+         */
+        void normalizeCentroids(std::vector< std::vector<double> > &centroids) const;
+
+
+        /**
+         * @brief データの重み
+         * @return 重みなしなら 1
+         */
+        double sampleWeight(const std::size_t data_index) const;
+
+
+        /**
+         * @brief 空のクラスタの再設定
+         * @details 空のクラスタごとに、誤差の2乗和が最大のクラスタで重心から最も遠いデータを選び、
+         * そのデータを空のクラスタに移して新しい重心にする (誤差最大のクラスタを分割する)。
+         * 空のクラスタがなければ O(データ数) で終わる
+         * @param[in] dataset クラスタリングするデータセット
+         * @param[in,out] centroids 各クラスタの重心位置 (移したデータの分も更新する)
+         * @return 再設定したクラスタ数
+         */
+        template<class Dataset>
+        std::size_t reseedEmptyClusters(const Dataset &dataset, std::vector< std::vector<double> > &centroids);
+
+
+        /**
+         * @brief 現在のラベルでの評価値 (各データと所属クラスタ重心との距離の2乗の総和)
+         * @param[in] dataset クラスタリングするデータセット
+         * @param[in] centroids 各クラスタの重心位置
+         */
+        template<class Dataset>
+        double calcInertia(const Dataset &dataset, const std::vector< std::vector<double> > &centroids) const;
+
+
+        /**
+         * @brief 乱数によるクラスタ重心の初期化
+         * @tparam DataType クラスタリングするデータの型
+         * @param[in] dataset クラスタリングするデータセット
+         * @param[in] num_clusters クラスタ数
+         * @param[out] centroids 各クラスタの重心位置
+         */
+        template<class Dataset>
+        void initCentroidsRandom(const Dataset &dataset, const std::size_t num_clusters, std::vector< std::vector<double> > &centroids);
+
+
+        /**
+         * @brief 頭から順番にクラスタリングして重心初期化
+         * @see Kmeans::initCentroidsRandom
+         */
+        template<class Dataset>
+        void initCentroidsUniform(const Dataset &dataset, const std::size_t num_clusters, std::vector< std::vector<double> > &centroids);
+
+
+        /**
+         * @brief k-means++によるクラスタ重心の初期化
+         * @see Kmeans::initCentroidsRandom
+         */
+        template<class Dataset>
+        void initCentroidsPlusplus(const Dataset &dataset, const std::size_t num_clusters, std::vector< std::vector<double> > &centroids);
+
+
+        /**
+         * @brief k-means|| によるクラスタ重心の初期化
+         * @details 各ラウンドで距離の2乗に比例した確率で候補点をまとめて選び (並列)、
+         * 最後に候補点を最近傍のデータ数で重み付けした k-means++ で num_clusters 個に絞る
+         * @see Kmeans::initCentroidsRandom
+         */
+        template<class Dataset>
+        void initCentroidsScalable(const Dataset &dataset, const std::size_t num_clusters, std::vector< std::vector<double> > &centroids);
+
+
+        /**
+         * @brief 重心候補を1つ加えたときの各データの最近傍距離の2乗を計算 (並列)
+         * @param[in] dataset クラスタリングするデータセット
+         * @param[in] point 追加する重心候補
+         * @param[in] distance_list 現在の最近傍距離の2乗
+         * @param[out] updated_distance_list 更新後の最近傍距離の2乗 (distance_list と同じでも可)
+         * @return 更新後の距離の2乗の総和
+         */
+        template<class Dataset>
+        double updateDistanceList(const Dataset &dataset, const std::size_t point_index, const std::vector<double> &distance_list, std::vector<double> &updated_distance_list) const;
+
+
+        /**
+         * @brief ラベルの更新
+         * @tparam DataType クラスタリングするデータの型
+         * @param[in] dataset クラスタリングするデータセット
+         * @param[out] centroids 各クラスタの重心位置
+         * @param[out] num_changed 前回からラベルが変わったデータ数 (前回のラベルがなければデータ数)
+         * @return 評価値
+         * @details 変わったデータ数はラベルを書き込むときに数える
+         */
+        template<class Dataset>
+        double updateLabel(const Dataset &dataset, const std::vector< std::vector<double> > &centroids, std::size_t &num_changed);
+
+
+        /**
+         * @brief 全クラスタ重心との総当たりによるラベルの更新
+         * @see KMeans::updateLabel
+         */
+        template<class Dataset>
+        double updateLabelBruteForce(const Dataset &dataset, const std::vector< std::vector<double> > &centroids, std::size_t &num_changed);
+
+
+        /**
+         * @brief クラスタ重心の kd-tree によるラベルの更新
+         * @see KMeans::updateLabel
+         */
+        template<class Dataset>
+        double updateLabelKdTree(const Dataset &dataset, const std::vector< std::vector<double> > &centroids, std::size_t &num_changed);
+
+
+        /**
+         * @brief 行列積によるラベルの更新
+         * @details データとクラスタ重心をタイルに分けて内積を行列積で計算し、タイルごとに最近傍を選ぶ @n
+         * 高次元 (次数 16 以上程度) でクラスタ数が多いときに速い
+         * @see KMeans::updateLabel
+         */
+        template<class Dataset>
+        double updateLabelGemm(const Dataset &dataset, const std::vector< std::vector<double> > &centroids, std::size_t &num_changed);
+
+
+        /**
+         * @brief filtering algorithm によるラベルの更新
+         * @details <a href="https://www.cs.umd.edu/~mount/Papers/pami02.pdf">An Efficient k-Means Clustering Algorithm: Analysis and Implementation | Kanungo et al. (2002)</a>
+         * @attention 先に KMeans::buildFilteringTree が必要
+         * @see KMeans::updateLabel
+         */
+        template<class Dataset>
+        double updateLabelFiltering(const Dataset &dataset, const std::vector< std::vector<double> > &centroids, std::size_t &num_changed);
+
+
+        /**
+         * @brief filtering algorithm 用にデータの kd-tree を作成
+         * @param[in] dataset クラスタリングするデータセット
+         */
+        template<class Dataset>
+        void buildFilteringTree(const Dataset &dataset);
+
+
+        /**
+         * @brief filtering algorithm 用の kd-tree のノード作成 (再帰)
+         * @param[in] begin KMeans::m_filtering_indices の開始位置
+         * @param[in] end KMeans::m_filtering_indices の終了位置
+         * @return 作成したノードのインデックス
+         */
+        template<class Dataset>
+        std::size_t buildFilteringNode(const Dataset &dataset, const std::size_t begin, const std::size_t end);
+
+
+        /**
+         * @brief ノード内のデータの最近傍になり得ない候補重心を除いて子ノードへ (再帰)
+         * @param[in] node_index ノードのインデックス
+         * @param[in,out] candidates 候補重心のバッファ (子ノードの候補は後ろに追記する)
+         * @param[in] offset candidates 内の候補の開始位置
+         * @param[in] num_candidates 候補数
+         * @param[in,out] nearest_list 各データの最近傍クラスタ
+         * @param[in,out] num_changed ラベルが変わったデータ数 (このノードの分を足す)
+         * @return ノード内の距離の2乗の総和
+         */
+        template<class Dataset>
+        double filterCandidates(const Dataset &dataset, const std::vector< std::vector<double> > &centroids, const std::size_t node_index,
+                                std::vector<std::size_t> &candidates, const std::size_t offset, const std::size_t num_candidates, std::vector<std::uint32_t> &nearest_list,
+                                std::size_t &num_changed) const;
+
+
+        /**
+         * @brief クラスタ重心の計算
+         * @tparam DataType クラスタリングするデータの型
+         * @param[in] dataset クラスタリングするデータセット
+         * @param[out] centroids 各クラスタの重心位置
+         * @attention KMeans::m_labels が必要
+         */
+        template<class Dataset>
+        void calcCentroids(const Dataset &dataset, std::vector< std::vector<double> > &centroids);
+        
+        
+        /** @brief 各データのクラスタID */
+        ClusterLabels m_labels;
+
+
+        /**
+         * @brief filtering algorithm 用の kd-tree のノード
+         * @details データの範囲とその外接直方体、総和、2乗ノルムの総和を持つ
+         */
+        struct FilteringNode
+        {
+            std::size_t begin;          /**< KMeans::m_filtering_indices の開始位置 */
+            std::size_t end;            /**< KMeans::m_filtering_indices の終了位置 */
+            std::size_t child[2];       /**< 子ノードのインデックス (葉なら 0) */
+            std::vector<double> lower;  /**< 外接直方体の下限 */
+            std::vector<double> upper;  /**< 外接直方体の上限 */
+            std::vector<double> sum;    /**< データの総和 */
+            double squared_norm_sum;    /**< データの2乗ノルムの総和 */
+        };
+
+
+        /** @brief filtering algorithm 用の kd-tree (先頭が根) */
+        std::vector<FilteringNode> m_filtering_nodes;
+
+
+        /** @brief kd-tree のノード順に並べたデータのインデックス */
+        std::vector<std::size_t> m_filtering_indices;
+
+    
+        /** @brief 最大試行回数 */
+        std::size_t m_max_iteration;
+
+    
+        /** @brief 収束判定閾値 */
+        double m_tolerance;
+
+
+        /** @brief k-means++で初期化するときの最大試行回数 */
+        std::size_t m_max_pp_trial;
+
+
+        /** @brief 初期化に使う乱数器 */
+        std::mt19937 m_engine;
+
+
+        /** @brief k-means|| で1ラウンドに選ぶ候補数の倍率 */
+        double m_oversampling_factor;
+
+
+        /** @brief k-means|| のラウンド数 */
+        std::size_t m_num_rounds;
+
+
+        /** @brief 初期化を変えてクラスタリングする回数 */
+        std::size_t m_num_init;
+
+
+        /** @brief 直前のクラスタリング結果の情報 */
+        Result m_result;
+
+
+        /** @brief ラベル更新の方法 (設定値) */
+        LabelMethod m_label_method;
+
+
+        /** @brief 各データの重み (重みなしなら NULL、クラスタリング中だけ有効) */
+        const std::vector<double> *m_weights;
+
+
+        /** @brief ラベル更新の方法 (KMeans::AUTO を解決した値) */
+        LabelMethod m_current_label_method;
+
+
+        /** @brief データとクラスタ重心の距離 */
+        DistanceType m_distance_type;
+
+
+        /** @brief 各データのノルムの逆数 (KMeans::COSINE のときだけ使う) */
+        std::vector<double> m_inverse_norms;
+
+
+        /** @brief クラスタリングするデータの次数 */
+        std::size_t m_dim;
+        
+        
+    };  // end of k-means class
 
 
 
@@ -191,8 +898,39 @@ namespace scl
         : m_max_iteration(10),
           m_tolerance(0.1),
           m_max_pp_trial(3),
+          m_engine(scl::rng::makeEngine(scl::rng::randomSeed())),
+          m_oversampling_factor(2.0),
+          m_num_rounds(5),
+          m_num_init(1),
+          m_label_method(KMeans::AUTO),
+          m_weights(NULL),
+          m_current_label_method(KMeans::BRUTE_FORCE),
+          m_distance_type(KMeans::EUCLIDEAN),
+          m_dim(0)
+    {
+        m_result.inertia = 0.0;
+        m_result.num_iterations = 0;
+        m_result.is_converged = false;
+    }
+
+
+    KMeans::KMeans(const std::uint64_t seed)
+        : m_max_iteration(10),
+          m_tolerance(0.1),
+          m_max_pp_trial(3),
+          m_engine(scl::rng::makeEngine(seed)),
+          m_oversampling_factor(2.0),
+          m_num_rounds(5),
+          m_num_init(1),
+          m_label_method(KMeans::AUTO),
+          m_weights(NULL),
+          m_current_label_method(KMeans::BRUTE_FORCE),
+          m_distance_type(KMeans::EUCLIDEAN),
           m_dim(0)
     {
+        m_result.inertia = 0.0;
+        m_result.num_iterations = 0;
+        m_result.is_converged = false;
     }
 
 
@@ -209,8 +947,119 @@ namespace scl
     }
 
 
+    void KMeans::setScalableParameters(const double oversampling_factor, const std::size_t num_rounds)
+    {
+        m_oversampling_factor = oversampling_factor;
+        m_num_rounds = num_rounds;
+    }
+
+
+    void KMeans::setLabelMethod(const LabelMethod label_method)
+    {
+        m_label_method = label_method;
+    }
+
+
+    void KMeans::setDistanceType(const DistanceType distance_type)
+    {
+        m_distance_type = distance_type;
+    }
+
+
+    void KMeans::setNumInit(const std::size_t num_init)
+    {
+        m_num_init = std::max<std::size_t>(num_init, 1);
+    }
+
+
+    void KMeans::setSeed(const std::uint64_t seed)
+    {
+        m_engine = scl::rng::makeEngine(seed);
+    }
+
+
+    void KMeans::setRandomEngine(const std::mt19937 &engine)
+    {
+        m_engine = engine;
+    }
+
+
     template<class DataType>
     bool KMeans::clustering(const std::size_t dim, const std::vector<DataType> &dataset, const std::size_t num_clusters, std::vector< std::vector<double> > &centroids, const InitMethod method)
+    {
+        bool is_converged = clusteringDataset(dim, dataset, num_clusters, centroids, method);
+        m_labels.setDataIds(std::vector<std::size_t>());
+        return is_converged;
+    }
+
+
+    template<class DataType>
+    bool KMeans::clustering(const std::size_t dim, const std::vector<DataType> &dataset, const std::vector<std::size_t> &indices,
+                            const std::size_t num_clusters, std::vector< std::vector<double> > &centroids, const InitMethod method)
+    {
+        bool is_converged = clusteringDataset(dim, internal::IndexedDataset<DataType>(dataset, indices), num_clusters, centroids, method);
+
+        // クラスタの情報は dataset でのインデックスにする //
+        m_labels.setDataIds(indices);
+
+        return is_converged;
+    }
+
+
+    template<class DataType>
+    bool KMeans::clustering(const std::size_t dim, const std::vector<DataType> &dataset, const std::vector<std::size_t> &indices, const std::size_t begin, const std::size_t end,
+                            const std::size_t num_clusters, std::vector< std::vector<double> > &centroids, const InitMethod method)
+    {
+        // range check
+        if (begin > end || end > indices.size())
+        {
+            return false;
+        }
+
+        bool is_converged = clusteringDataset(dim, internal::IndexedDataset<DataType>(dataset, indices.empty() ? NULL : &indices[0] + begin, end - begin), num_clusters, centroids, method);
+        m_labels.setDataIds(std::vector<std::size_t>());
+        return is_converged;
+    }
+
+
+    template<class DataType>
+    bool KMeans::clustering(const std::size_t dim, const std::vector<DataType> &dataset, const std::vector<std::size_t> &indices, const std::size_t begin, const std::size_t end,
+                            const std::vector<double> &weights, const std::size_t num_clusters, std::vector< std::vector<double> > &centroids, const InitMethod method)
+    {
+        // size check
+        if (begin > end || end > indices.size() || weights.size() != end - begin)
+        {
+            return false;
+        }
+
+        m_weights = &weights;
+        bool is_converged = clusteringDataset(dim, internal::IndexedDataset<DataType>(dataset, indices.empty() ? NULL : &indices[0] + begin, end - begin), num_clusters, centroids, method);
+        m_weights = NULL;
+        m_labels.setDataIds(std::vector<std::size_t>());
+        return is_converged;
+    }
+
+
+    template<class DataType>
+    bool KMeans::clustering(const std::size_t dim, const std::vector<DataType> &dataset, const std::vector<double> &weights,
+                            const std::size_t num_clusters, std::vector< std::vector<double> > &centroids, const InitMethod method)
+    {
+        // size check
+        if (weights.size() != dataset.size())
+        {
+            return false;
+        }
+
+        m_weights = &weights;
+        bool is_converged = clusteringDataset(dim, dataset, num_clusters, centroids, method);
+        m_weights = NULL;
+        m_labels.setDataIds(std::vector<std::size_t>());
+        return is_converged;
+    }
+
+
+    template<class Dataset>
+    bool KMeans::clusteringDataset(const std::size_t dim, const Dataset &dataset, const std::size_t num_clusters, std::vector< std::vector<double> > &centroids, const InitMethod method)
     {
         // size check
         if (dim == 0 || dataset.empty() || num_clusters == 0)
@@ -218,48 +1067,84 @@ namespace scl
             return false;
         }
         m_dim = dim;
+        calcInverseNorms(dataset);
+
+
+        // 初期化を変えて複数回 //
+        if (m_num_init > 1 && method != KMeans::MANUAL)
+        {
+            return clusteringRestarts(dim, dataset, num_clusters, centroids, method);
+        }
+
+
+        // 前回のラベルは使わない (RANDOM, UNIFORM は初期化でラベルを作る) //
+        m_labels.clear();
 
 
         // クラスタ重心の初期化 //
-        switch (method)
+        if ( !initCentroidsDataset(dataset, num_clusters, centroids, method) )
         {
-        case KMeans::RANDOM:
+            return false;
+        }
+
+
+        // ラベル更新方法の決定 //
+        m_current_label_method = m_label_method;
+        if (m_current_label_method == KMeans::AUTO)
         {
-            initCentroidsRandom(dataset, num_clusters, centroids);
-            break;
+            // 低次元でクラスタ数が多いときは kd-tree での枝刈りがよく効く //
+            // 高次元では行列積にまとめた方がキャッシュを有効に使える //
+            m_current_label_method = KMeans::BRUTE_FORCE;
+            if (dim <= 4 && num_clusters >= 32)
+            {
+                m_current_label_method = KMeans::FILTERING;
+            }
+            else if (dim >= 16 && num_clusters >= 16)
+            {
+                m_current_label_method = KMeans::GEMM;
+            }
         }
-        case KMeans::UNIFORM:
+        if (m_distance_type == KMeans::COSINE)
         {
-            initCentroidsUniform(dataset, num_clusters, centroids);
-            break;
+            // 重心が単位ベクトルなので、最近傍は内積の最大 (行列積の argmax) //
+            m_current_label_method = KMeans::GEMM;
         }
-        case KMeans::PLUSPLUS:
+        if (m_current_label_method == KMeans::FILTERING && m_weights != NULL)
         {
-            initCentroidsPlusplus(dataset, num_clusters, centroids);
-            break;
+            // ノードの総和が重みを持たないので kd-tree で探索する //
+            m_current_label_method = KMeans::KD_TREE;
         }
-        case KMeans::MANUAL:
+        if (m_current_label_method == KMeans::FILTERING)
         {
-            if (num_clusters != centroids.size())
-            {
-                return false;
-            }
+            buildFilteringTree(dataset);
         }
-        } // end of switch method
 
 
         // k-means
         double pre_cost(-m_tolerance);  // 最初の一回で収束しないように //
         bool is_converged(false);
         std::vector< std::vector<double> > pre_centroids(centroids);
-        for (std::size_t iteration = 0; iteration < m_max_iteration; ++iteration)
+        bool is_reseeded(false);
+        std::size_t iteration(0);
+        while (iteration < m_max_iteration)
         {
+            ++iteration;
+            
             // update label
-            double cost = updateLabel(dataset, centroids);
+            std::size_t num_changed(0);
+            double cost = updateLabel(dataset, centroids, num_changed);
+
+            // ラベルが1つも変わらなければ重心も変わらないので終了 //
+            if (!is_reseeded && num_changed == 0)
+            {
+                is_converged = true;
+                break;
+            }
 
              // update centroids
             centroids.swap(pre_centroids);
             calcCentroids(dataset, centroids);
+            is_reseeded = ( reseedEmptyClusters(dataset, centroids) > 0 );
 
             // check converged ver.1
             // double error(cost - pre_cost);
@@ -282,17 +1167,153 @@ namespace scl
                     }
                 }
 
-                if (max_change < m_tolerance)
+                if (!is_reseeded && max_change < m_tolerance)
                 {
                     is_converged = true;
                     break;
                 }
             }
         }
+
+        // save result
+        m_result.inertia = calcInertia(dataset, centroids);
+        m_result.num_iterations = iteration;
+        m_result.is_converged = is_converged;
+
         return is_converged;
     }
 
 
+    void KMeans::copyParameters(const KMeans &other)
+    {
+        m_max_iteration = other.m_max_iteration;
+        m_tolerance = other.m_tolerance;
+        m_max_pp_trial = other.m_max_pp_trial;
+        m_oversampling_factor = other.m_oversampling_factor;
+        m_num_rounds = other.m_num_rounds;
+        m_num_init = other.m_num_init;
+        m_label_method = other.m_label_method;
+        m_weights = other.m_weights;
+        m_distance_type = other.m_distance_type;
+        m_dim = other.m_dim;
+    }
+
+
+    template<class Dataset>
+    bool KMeans::initCentroidsDataset(const Dataset &dataset, const std::size_t num_clusters, std::vector< std::vector<double> > &centroids, const InitMethod method)
+    {
+        switch (method)
+        {
+        case KMeans::RANDOM:
+        {
+            initCentroidsRandom(dataset, num_clusters, centroids);
+            break;
+        }
+        case KMeans::UNIFORM:
+        {
+            initCentroidsUniform(dataset, num_clusters, centroids);
+            break;
+        }
+        case KMeans::PLUSPLUS:
+        {
+            initCentroidsPlusplus(dataset, num_clusters, centroids);
+            break;
+        }
+        case KMeans::SCALABLE:
+        {
+            initCentroidsScalable(dataset, num_clusters, centroids);
+            break;
+        }
+        case KMeans::MANUAL:
+        {
+            if (num_clusters != centroids.size())
+            {
+                return false;
+            }
+        }
+        } // end of switch method
+        normalizeCentroids(centroids);
+        return true;
+    }
+
+
+    template<class DataType>
+    void KMeans::initCentroids(const std::size_t dim, const std::vector<DataType> &dataset, const std::size_t num_clusters, std::vector< std::vector<double> > &centroids, const InitMethod method)
+    {
+        // size check
+        if (dim == 0 || dataset.empty() || num_clusters == 0)
+        {
+            return;
+        }
+        m_dim = dim;
+        m_labels.clear();
+        calcInverseNorms(dataset);
+        initCentroidsDataset(dataset, num_clusters, centroids, method);
+    }
+
+
+    template<class DataType>
+    void KMeans::initCentroids(const std::size_t dim, const std::vector<DataType> &dataset, const std::vector<double> &weights,
+                               const std::size_t num_clusters, std::vector< std::vector<double> > &centroids, const InitMethod method)
+    {
+        // size check
+        if (weights.size() != dataset.size())
+        {
+            return;
+        }
+
+        m_weights = &weights;
+        initCentroids(dim, dataset, num_clusters, centroids, method);
+        m_weights = NULL;
+    }
+
+
+    template<class Dataset>
+    bool KMeans::clusteringRestarts(const std::size_t dim, const Dataset &dataset, const std::size_t num_clusters, std::vector< std::vector<double> > &centroids, const InitMethod method)
+    {
+        // 各回は別の KMeans で実行 (バッファは各回の中で使い回す) //
+        // シードは回ごとに分けるので、スレッド数によらず同じ結果になる //
+        const std::size_t num_init(m_num_init);
+        const std::uint64_t base_seed = (static_cast<std::uint64_t>(m_engine()) << 32) | m_engine();
+        std::vector<KMeans> runs;
+        runs.reserve(num_init);
+        std::vector< std::vector< std::vector<double> > > run_centroids(num_init);
+        for (std::size_t run_index = 0; run_index < num_init; ++run_index)
+        {
+            runs.push_back(KMeans(scl::rng::streamSeed(base_seed, run_index)));
+            runs[run_index].copyParameters(*this);
+            runs[run_index].m_num_init = 1;
+        }
+
+        #pragma omp parallel for schedule(dynamic)
+        for (std::size_t run_index = 0; run_index < num_init; ++run_index)
+        {
+            runs[run_index].clusteringDataset(dim, dataset, num_clusters, run_centroids[run_index], method);
+        }
+
+        // 評価値が最小の結果 //
+        std::size_t best_index(0);
+        for (std::size_t run_index = 1; run_index < num_init; ++run_index)
+        {
+            if (runs[run_index].m_result.inertia < runs[best_index].m_result.inertia)
+            {
+                best_index = run_index;
+            }
+        }
+
+        // copy results
+        KMeans &best(runs[best_index]);
+        m_labels.swap(best.m_labels);
+        m_filtering_nodes.swap(best.m_filtering_nodes);
+        m_filtering_indices.swap(best.m_filtering_indices);
+        m_current_label_method = best.m_current_label_method;
+        m_result = best.m_result;
+        centroids.swap(run_centroids[best_index]);
+
+        return m_result.is_converged;
+    }
+
+
     template<class DataType>
     bool KMeans::clustering(const std::size_t dim, const std::vector<DataType> &dataset, const std::size_t num_clusters, const InitMethod method)
     {
@@ -303,36 +1324,51 @@ namespace scl
 
     const std::vector< std::vector<std::size_t> >& KMeans::getClusters() const
     {
-        return m_clusterid_to_dataids;
+        return m_labels.getClusters();
     }
 
 
     const std::vector<std::size_t>& KMeans::getCluster(const std::size_t cluster_id) const
     {
-        return m_clusterid_to_dataids.at(cluster_id);
+        return m_labels.getCluster(cluster_id);
     }
 
 
-    template<class DataType>
-    void KMeans::initCentroidsRandom(const std::vector<DataType> &dataset, const std::size_t num_clusters, std::vector< std::vector<double> > &centroids)
+    const std::vector<std::uint32_t>& KMeans::getLabels() const
+    {
+        return m_labels.getLabels();
+    }
+
+
+    const ClusterLabels& KMeans::getClusterLabels() const
+    {
+        return m_labels;
+    }
+
+
+    const KMeans::Result& KMeans::getResult() const
+    {
+        return m_result;
+    }
+
+
+    template<class Dataset>
+    void KMeans::initCentroidsRandom(const Dataset &dataset, const std::size_t num_clusters, std::vector< std::vector<double> > &centroids)
     {
         // データセットのインデックスリストを作成 //
         std::vector<std::size_t> shuffle_indices(dataset.size());
         std::iota(shuffle_indices.begin(), shuffle_indices.end(), 0);
 
          // シャッフル //
-        std::random_device seed_gen;
-        std::mt19937 engine(seed_gen());
-        std::shuffle(shuffle_indices.begin(), shuffle_indices.end(), engine);
+        std::shuffle(shuffle_indices.begin(), shuffle_indices.end(), m_engine);
     
         // init label
-        m_clusterid_to_dataids.clear();
-        m_clusterid_to_dataids.resize(num_clusters);
+        std::vector<std::uint32_t> &labels = m_labels.resetLabels(dataset.size(), num_clusters);
         for (std::size_t shuffle_index = 0; shuffle_index < shuffle_indices.size(); ++shuffle_index)
         {
             std::size_t data_index = shuffle_indices.at(shuffle_index);
             std::size_t cluster_index = data_index % num_clusters;
-            m_clusterid_to_dataids[cluster_index].push_back(data_index);
+            labels[data_index] = static_cast<std::uint32_t>(cluster_index);
         }
     
         // init centroids
@@ -341,16 +1377,15 @@ namespace scl
     }
 
 
-    template<class DataType>
-    void KMeans::initCentroidsUniform(const std::vector<DataType> &dataset, const std::size_t num_clusters, std::vector< std::vector<double> > &centroids)
+    template<class Dataset>
+    void KMeans::initCentroidsUniform(const Dataset &dataset, const std::size_t num_clusters, std::vector< std::vector<double> > &centroids)
     {
         // init label
-        m_clusterid_to_dataids.clear();
-        m_clusterid_to_dataids.resize(num_clusters);
+        std::vector<std::uint32_t> &labels = m_labels.resetLabels(dataset.size(), num_clusters);
         for (std::size_t data_index = 0; data_index < dataset.size(); ++data_index)
         {
             std::size_t cluster_index = data_index % num_clusters;
-            m_clusterid_to_dataids[cluster_index].push_back(data_index);
+            labels[data_index] = static_cast<std::uint32_t>(cluster_index);
         }
 
         // init centroids
@@ -359,213 +1394,923 @@ namespace scl
      }
 
 
-    template<class DataType>
-    void KMeans::initCentroidsPlusplus(const std::vector<DataType> &dataset, const std::size_t num_clusters, std::vector< std::vector<double> > &centroids)
+    template<class Dataset>
+    void KMeans::initCentroidsPlusplus(const Dataset &dataset, const std::size_t num_clusters, std::vector< std::vector<double> > &centroids)
     {
+        typedef typename Dataset::value_type DataType;
+
         // init data
         const std::size_t dim(m_dim);
+        const std::size_t num_data(dataset.size());
+        const std::size_t num_trials(std::max<std::size_t>(m_max_pp_trial, 1));
         centroids.clear();
         centroids.reserve(num_clusters);
 
-        // 乱数器の生成 //
-        std::random_device seed_gen;
-        std::mt19937 engine(seed_gen());
-        std::uniform_int_distribution<std::size_t> index_distribution(0, dataset.size()-1);  // [min, max] 最大値以下 //
-        std::uniform_real_distribution<double> threshold_distribution(0.0, 1.0);              // [min, max) 最大値未満 //
+        // 乱数の分布 //
+        std::uniform_int_distribution<std::size_t> index_distribution(0, num_data-1);  // [min, max] 最大値以下 //
+        std::uniform_real_distribution<double> threshold_distribution(0.0, 1.0);       // [min, max) 最大値未満 //
+
+        // 距離リスト (試行ごとにコピーせず、バッファを入れ替えて使い回す) //
+        std::vector<double> distance_list(num_data, std::numeric_limits<double>::max());
+        std::vector<double> proposed_distance_list(num_data);
+        std::vector<double> best_distance_list(num_data);
+        std::vector<double> thresholds(num_trials);
+        std::vector<std::size_t> proposed_indices(num_trials);
 
-        // 1個目のクラスタ重心位置をデータからランダムに選択 //
+        // 1個目のクラスタ重心位置をデータからランダムに選択 (重み付きなら重みに比例した確率) //
+        std::size_t next_index = index_distribution(m_engine);
+        if (m_weights != NULL)
         {
-            std::size_t random_index = index_distribution(engine);
-            const DataType &target(dataset.at(random_index));
-            std::vector<double> centroid(dim, 0.0);
-            for (std::size_t value_index = 0; value_index < dim; ++value_index)
+            std::vector<double> first_threshold(1, std::accumulate(m_weights->begin(), m_weights->end(), 0.0) * threshold_distribution(m_engine));
+            std::vector<std::size_t> first_index(1, next_index);
+            sampleIndices(*m_weights, first_threshold, first_index);
+            next_index = first_index.front();
+        }
+        double sum_squared_distance = updateDistanceList(dataset, next_index, distance_list, distance_list);
+
+        for (std::size_t cluster_index = 0; cluster_index < num_clusters; ++cluster_index)
+        {
+            // add centroid
             {
-                centroid[value_index] = static_cast<double>(target[value_index]);
+                const DataType &target(dataset.at(next_index));
+                std::vector<double> centroid(dim, 0.0);
+                for (std::size_t value_index = 0; value_index < dim; ++value_index)
+                {
+                    centroid[value_index] = static_cast<double>(target[value_index]);
+                }
+                centroids.push_back(centroid);
+            }
+            if (centroids.size() == num_clusters)
+            {
+                break;
             }
-            centroids.push_back(centroid);
-        }
 
-        // initialize list data
-        std::vector<double> distance_list(dataset.size());
-        double sum_squared_distance(0.0);
-        for (std::size_t data_index = 0; data_index < dataset.size(); ++data_index)
+            // 次の重心位置の候補をまとめて選ぶ (データの走査は1回) //
+            for (std::size_t trial = 0; trial < num_trials; ++trial)
+            {
+                thresholds[trial] = sum_squared_distance * threshold_distribution(m_engine);
+            }
+            std::sort(thresholds.begin(), thresholds.end());
+            if ( !sampleIndices(distance_list, thresholds, proposed_indices) )
+            {
+                // 全データが重心と一致している //
+                std::fill(proposed_indices.begin(), proposed_indices.end(), index_distribution(m_engine));
+            }
+
+            // 各候補の評価値計算 //
+            double best_sum_squared_distance(std::numeric_limits<double>::max());
+            for (std::size_t trial = 0; trial < num_trials; ++trial)
+            {
+                double proposed_sum_squared_distance = updateDistanceList(dataset, proposed_indices[trial], distance_list, proposed_distance_list);
+
+                // update best data
+                if (proposed_sum_squared_distance < best_sum_squared_distance)
+                {
+                    next_index = proposed_indices[trial];
+                    best_distance_list.swap(proposed_distance_list);
+                    best_sum_squared_distance = proposed_sum_squared_distance;
+                }
+            } // end of each trial
+
+            // update for next step
+            distance_list.swap(best_distance_list);
+            sum_squared_distance = best_sum_squared_distance;
+
+        } // end of each cluster
+    }
+
+
+    template<class Dataset>
+    void KMeans::initCentroidsScalable(const Dataset &dataset, const std::size_t num_clusters, std::vector< std::vector<double> > &centroids)
+    {
+        typedef typename Dataset::value_type DataType;
+
+        // init data
+        const std::size_t dim(m_dim);
+        const std::size_t num_data(dataset.size());
+        const std::size_t num_trials(std::max<std::size_t>(m_max_pp_trial, 1));
+        const double oversampling(m_oversampling_factor * static_cast<double>(num_clusters));
+        centroids.clear();
+        centroids.reserve(num_clusters);
+
+        // 乱数の分布 //
+        std::uniform_int_distribution<std::size_t> index_distribution(0, num_data-1);  // [min, max] 最大値以下 //
+        std::uniform_real_distribution<double> threshold_distribution(0.0, 1.0);       // [min, max) 最大値未満 //
+
+        // 1個目の候補をデータからランダムに選択 (重み付きなら重みに比例した確率) //
+        std::vector<std::size_t> candidate_indices(1, index_distribution(m_engine));
+        if (m_weights != NULL)
         {
-            distance_list[data_index] = calcSquaredDistance(dataset.at(data_index), centroids.back());
-            sum_squared_distance += distance_list[data_index];
+            std::vector<double> first_threshold(1, std::accumulate(m_weights->begin(), m_weights->end(), 0.0) * threshold_distribution(m_engine));
+            sampleIndices(*m_weights, first_threshold, candidate_indices);
         }
+        std::vector<std::size_t> nearest_candidate(num_data, 0);
+        std::vector<double> distance_list(num_data, std::numeric_limits<double>::max());
+        double sum_squared_distance = updateDistanceList(dataset, candidate_indices.front(), distance_list, distance_list);
 
-        // k-means++
-        for (std::size_t cluster_index = 1; cluster_index < num_clusters; ++cluster_index)
+        // oversampling
+        std::vector<char> is_selected(num_data, 0);
+        for (std::size_t round = 0; round < m_num_rounds && sum_squared_distance > 0.0; ++round)
         {
-            // 次の重心位置を決める試行計算 //
-            std::vector<double> next_centroid(centroids.back());
-            std::vector<double> best_distance_list(distance_list);
-            double best_sum_squared_distance(sum_squared_distance);
-    
-            for (std::size_t trial = 0; trial < m_max_pp_trial; ++trial)
+            // 各データを独立に選ぶ (乱数はインデックスから作るので並列でも結果は同じ) //
+            const std::uint64_t round_seed = (static_cast<std::uint64_t>(m_engine()) << 32) | m_engine();
+            #pragma omp parallel for
+            for (std::size_t data_index = 0; data_index < num_data; ++data_index)
             {
-                std::vector<double> proposed_centroid(centroids.back());
-                std::vector<double> proposed_distance_list(distance_list);
-                double proposed_sum_squared_distance(0.0);
+                double probability = oversampling * distance_list[data_index] / sum_squared_distance;
+                is_selected[data_index] = (scl::rng::hashedUniform(round_seed, data_index) < probability);
+            }
 
-                // 次の重心位置を決める閾値を設定 //
-                double threshold = sum_squared_distance * threshold_distribution(engine);
+            const std::size_t first_new_candidate(candidate_indices.size());
+            for (std::size_t data_index = 0; data_index < num_data; ++data_index)
+            {
+                if (is_selected[data_index])
+                {
+                    candidate_indices.push_back(data_index);
+                }
+            }
+            if (first_new_candidate == candidate_indices.size())
+            {
+                continue;
+            }
 
-                for (std::size_t data_index = 0; data_index < dataset.size(); ++data_index)
+            // 新しい候補までの距離で更新 //
+            const std::size_t num_candidates(candidate_indices.size());
+            sum_squared_distance = scl::parallel::sum(num_data, [&](const std::size_t data_index)
+            {
+                for (std::size_t candidate_id = first_new_candidate; candidate_id < num_candidates; ++candidate_id)
                 {
-                    threshold -= distance_list[data_index];
-                    if (threshold < 0)
+                    double squared_distance = sampleWeight(data_index) * calcDataDistance(dataset, data_index, candidate_indices[candidate_id]);
+                    if (squared_distance < distance_list[data_index])
                     {
-                        // new centroid
-                        const DataType &target(dataset.at(data_index));
-                        for (std::size_t value_index = 0; value_index < dim; ++value_index)
-                        {
-                            proposed_centroid[value_index] = static_cast<double>(target[value_index]);
-                        }
-                        break;
+                        distance_list[data_index] = squared_distance;
+                        nearest_candidate[data_index] = candidate_id;
                     }
                 }
+                return distance_list[data_index];
+            });
+        }
+
+        // 候補の重み = 最近傍になっているデータ数 (重みの和) //
+        const std::size_t num_candidates(candidate_indices.size());
+        std::vector<double> weights(num_candidates, 0.0);
+        for (std::size_t data_index = 0; data_index < num_data; ++data_index)
+        {
+            weights[nearest_candidate[data_index]] += sampleWeight(data_index);
+        }
+
+        // 重み付き k-means++ で num_clusters 個に絞る (候補数は少ないので直列) //
+        std::vector<std::size_t> selected_candidates;
+        if (num_candidates <= num_clusters)
+        {
+            selected_candidates.resize(num_candidates);
+            std::iota(selected_candidates.begin(), selected_candidates.end(), 0);
+        }
+        else
+        {
+            std::vector<double> candidate_distance_list(num_candidates, std::numeric_limits<double>::max());
+            std::vector<double> weighted_distance_list(num_candidates, 0.0);
+            std::vector<double> thresholds(num_trials);
+            std::vector<std::size_t> proposed_candidates(num_trials);
+
+            // 1個目は重みに比例した確率で選ぶ //
+            sampleIndices(weights, std::vector<double>(1, std::accumulate(weights.begin(), weights.end(), 0.0) * threshold_distribution(m_engine)), proposed_candidates);
+            std::size_t next_candidate(proposed_candidates.front());
+
+            while (true)
+            {
+                selected_candidates.push_back(next_candidate);
+                if (selected_candidates.size() == num_clusters)
+                {
+                    break;
+                }
+
+                // update distance
+                double sum_weighted_distance(0.0);
+                for (std::size_t candidate_id = 0; candidate_id < num_candidates; ++candidate_id)
+                {
+                    double squared_distance = calcDataDistance(dataset, candidate_indices[candidate_id], candidate_indices[next_candidate]);
+                    candidate_distance_list[candidate_id] = std::min(candidate_distance_list[candidate_id], squared_distance);
+                    weighted_distance_list[candidate_id] = weights[candidate_id] * candidate_distance_list[candidate_id];
+                    sum_weighted_distance += weighted_distance_list[candidate_id];
+                }
+
+                // 次の候補を選ぶ試行 //
+                for (std::size_t trial = 0; trial < num_trials; ++trial)
+                {
+                    thresholds[trial] = sum_weighted_distance * threshold_distribution(m_engine);
+                }
+                std::sort(thresholds.begin(), thresholds.end());
+                if ( !sampleIndices(weighted_distance_list, thresholds, proposed_candidates) )
+                {
+                    break;
+                }
 
-                // proposed_centroid 時の評価値計算 //
-                for (std::size_t data_index = 0; data_index < dataset.size(); ++data_index)
+                double best_cost(std::numeric_limits<double>::max());
+                for (std::size_t trial = 0; trial < num_trials; ++trial)
                 {
-                    double squared_distance = calcSquaredDistance(dataset.at(data_index), proposed_centroid);
-                    if ( squared_distance < distance_list[data_index] )
+                    double proposed_cost(0.0);
+                    for (std::size_t candidate_id = 0; candidate_id < num_candidates; ++candidate_id)
+                    {
+                        double squared_distance = calcDataDistance(dataset, candidate_indices[candidate_id], candidate_indices[proposed_candidates[trial]]);
+                        proposed_cost += weights[candidate_id] * std::min(candidate_distance_list[candidate_id], squared_distance);
+                    }
+                    if (proposed_cost < best_cost)
                     {
-                        proposed_distance_list[data_index] = squared_distance;
+                        best_cost = proposed_cost;
+                        next_candidate = proposed_candidates[trial];
                     }
-                    proposed_sum_squared_distance += proposed_distance_list[data_index];
                 }
+            }
+        }
 
-                // update best data
-                if (proposed_sum_squared_distance < best_sum_squared_distance)
+        // set centroids
+        for (std::size_t i = 0; i < selected_candidates.size(); ++i)
+        {
+            const DataType &target(dataset[candidate_indices[selected_candidates[i]]]);
+            std::vector<double> centroid(dim, 0.0);
+            for (std::size_t value_index = 0; value_index < dim; ++value_index)
+            {
+                centroid[value_index] = static_cast<double>(target[value_index]);
+            }
+            centroids.push_back(centroid);
+        }
+
+        // 候補が足りない場合 (重複データが多いなど) はランダムに補う //
+        while (centroids.size() < num_clusters)
+        {
+            const DataType &target(dataset.at(index_distribution(m_engine)));
+            std::vector<double> centroid(dim, 0.0);
+            for (std::size_t value_index = 0; value_index < dim; ++value_index)
+            {
+                centroid[value_index] = static_cast<double>(target[value_index]);
+            }
+            centroids.push_back(centroid);
+        }
+    }
+
+
+    template<class Dataset>
+    double KMeans::updateDistanceList(const Dataset &dataset, const std::size_t point_index, const std::vector<double> &distance_list, std::vector<double> &updated_distance_list) const
+    {
+        // 総和の順序を固定して、スレッド数によらず同じ値にする //
+        // 重み付きなら w * d^2 を持つ (min(w a, w b) = w min(a, b) なので更新はそのまま) //
+        return scl::parallel::sum(dataset.size(), [&](const std::size_t data_index)
+        {
+            double squared_distance = sampleWeight(data_index) * calcDataDistance(dataset, data_index, point_index);
+            updated_distance_list[data_index] = std::min(distance_list[data_index], squared_distance);
+            return updated_distance_list[data_index];
+        });
+    }
+
+
+    bool KMeans::sampleIndices(const std::vector<double> &weights, const std::vector<double> &thresholds, std::vector<std::size_t> &indices)
+    {
+        // 累積和が閾値を超えた最初のインデックスを選ぶ //
+        std::size_t threshold_index(0), last_positive_index(weights.size());
+        double cumulative_sum(0.0);
+        for (std::size_t index = 0; index < weights.size() && threshold_index < thresholds.size(); ++index)
+        {
+            if (weights[index] <= 0.0)
+            {
+                continue;
+            }
+            last_positive_index = index;
+            cumulative_sum += weights[index];
+            while (threshold_index < thresholds.size() && thresholds[threshold_index] < cumulative_sum)
+            {
+                indices[threshold_index++] = index;
+            }
+        }
+        if (last_positive_index == weights.size())
+        {
+            return false;
+        }
+
+        // 丸め誤差で残った閾値 //
+        for (; threshold_index < thresholds.size(); ++threshold_index)
+        {
+            indices[threshold_index] = last_positive_index;
+        }
+        return true;
+    }
+
+
+    template<class Dataset>
+    void KMeans::calcInverseNorms(const Dataset &dataset)
+    {
+        if (m_distance_type != KMeans::COSINE)
+        {
+            m_inverse_norms.clear();
+            return;
+        }
+
+        const std::size_t num_data(dataset.size());
+        m_inverse_norms.resize(num_data);
+        #pragma omp parallel for
+        for (std::size_t data_index = 0; data_index < num_data; ++data_index)
+        {
+            double norm = std::sqrt(calcDotProduct(dataset[data_index], dataset[data_index]));
+            m_inverse_norms[data_index] = (norm > 0.0) ? 1.0 / norm : 0.0;
+        }
+    }
+
+
+    template<class Dataset>
+    double KMeans::calcDataDistance(const Dataset &dataset, const std::size_t data_index_a, const std::size_t data_index_b) const
+    {
+        if (m_distance_type == KMeans::COSINE)
+        {
+            double cosine = calcDotProduct(dataset[data_index_a], dataset[data_index_b]) * m_inverse_norms[data_index_a] * m_inverse_norms[data_index_b];
+            return std::max(0.0, 1.0 - cosine);
+        }
+        return calcSquaredDistance(dataset[data_index_a], dataset[data_index_b]);
+    }
+
+
+    template<class Dataset>
+    double KMeans::calcCentroidDistance(const Dataset &dataset, const std::size_t data_index, const std::vector<double> &centroid) const
+    {
+        if (m_distance_type == KMeans::COSINE)
+        {
+            double cosine = calcDotProduct(dataset[data_index], centroid) * m_inverse_norms[data_index];
+            return std::max(0.0, 1.0 - cosine);
+        }
+        return calcSquaredDistance(dataset[data_index], centroid);
+    }
+
+
+    template<class DataTypeA, class DataTypeB>
+    double KMeans::calcDotProduct(const DataTypeA &point_a, const DataTypeB &point_b) const
+    {
+        const std::size_t dim(m_dim);
+        double dot_product(0.0);
+
+        #pragma omp simd reduction(+:dot_product)
+        for (std::size_t value_index = 0; value_index < dim; ++value_index)
+        {
+            dot_product += static_cast<double>(point_a[value_index]) * static_cast<double>(point_b[value_index]);
+        }
+        return dot_product;
+    }
+
+
+    void KMeans::normalizeCentroids(std::vector< std::vector<double> > &centroids) const
+    {
+        if (m_distance_type != KMeans::COSINE)
+        {
+            return;
+        }
+
+        for (std::size_t cluster_index = 0; cluster_index < centroids.size(); ++cluster_index)
+        {
+            std::vector<double> &centroid(centroids[cluster_index]);
+            double norm = std::sqrt(calcDotProduct(centroid, centroid));
+            if (norm > 0.0)
+            {
+                for (std::size_t value_index = 0; value_index < centroid.size(); ++value_index)
                 {
-                    next_centroid.swap(proposed_centroid);
-                    best_distance_list.swap(proposed_distance_list);
-                    best_sum_squared_distance = proposed_sum_squared_distance;
-                }            
-            
-            } // end of each trial
-        
-            // update for next step
-            centroids.push_back(next_centroid);
-            distance_list.swap(best_distance_list);
-            sum_squared_distance = best_sum_squared_distance;
-        
-        } // end of each cluster
+                    centroid[value_index] /= norm;
+                }
+            }
+        }
     }
 
 
     template<class DataTypeA, class DataTypeB>
-    double KMeans::calcSquaredDistance(const DataTypeA &point_a, const DataTypeB &point_b)
+    double KMeans::calcSquaredDistance(const DataTypeA &point_a, const DataTypeB &point_b) const
     {
-        double squared_distance(0.0);
+        typedef typename internal::SquaredDistanceType<DataTypeA, DataTypeB>::type ValueType;
+        const std::size_t dim(m_dim);
+        ValueType squared_distance(0);
 
-        for (std::size_t value_index = 0; value_index < m_dim; ++value_index)
+        #pragma omp simd reduction(+:squared_distance)
+        for (std::size_t value_index = 0; value_index < dim; ++value_index)
         {
-            double value_error = static_cast<double>(point_a[value_index]) - static_cast<double>(point_b[value_index]);
+            ValueType value_error = static_cast<ValueType>(point_a[value_index]) - static_cast<ValueType>(point_b[value_index]);
             squared_distance += (value_error * value_error);
         }
         
-        return squared_distance;
+        return static_cast<double>(squared_distance);
     }
 
 
-    template<class DataType>
-    double KMeans::updateLabel(const std::vector<DataType> &dataset, const std::vector< std::vector<double> > &centroids)
+    template<class Dataset>
+    double KMeans::updateLabel(const Dataset &dataset, const std::vector< std::vector<double> > &centroids, std::size_t &num_changed)
     {
+        // 前回のラベルがなければ全て変わったとみなす //
+        const bool has_labels(m_labels.getLabels().size() == dataset.size());
+
+        double cost(0.0);
+        switch (m_current_label_method)
+        {
+        case KMeans::KD_TREE:
+        {
+            cost = updateLabelKdTree(dataset, centroids, num_changed);
+            break;
+        }
+        case KMeans::FILTERING:
+        {
+            cost = updateLabelFiltering(dataset, centroids, num_changed);
+            break;
+        }
+        case KMeans::GEMM:
+        {
+            cost = updateLabelGemm(dataset, centroids, num_changed);
+            break;
+        }
+        default:
+        {
+            cost = updateLabelBruteForce(dataset, centroids, num_changed);
+            break;
+        }
+        }
+
+        if (!has_labels)
+        {
+            num_changed = dataset.size();
+        }
+        return cost;
+    }
+
+
+    template<class Dataset>
+    double KMeans::updateLabelBruteForce(const Dataset &dataset, const std::vector< std::vector<double> > &centroids, std::size_t &num_changed)
+    {
+        typedef typename Dataset::value_type DataType;
+
         // set size data
         const std::size_t dim(m_dim);
-    
-        // reset label
-        m_clusterid_to_dataids.clear();
-        m_clusterid_to_dataids.resize(centroids.size());
+        const std::size_t num_data(dataset.size());
+        const std::size_t num_clusters(centroids.size());
+
+        // クラスタ重心をデータに合わせた精度で連続領域にコピー (float or 8bit 整数なら float) //
+        typedef typename internal::CentroidValueType<DataType>::type CentroidValueType;
+        std::vector<CentroidValueType> centroid_buffer(num_clusters * dim);
+        for (std::size_t cluster_index = 0; cluster_index < num_clusters; ++cluster_index)
+        {
+            for (std::size_t value_index = 0; value_index < dim; ++value_index)
+            {
+                centroid_buffer[cluster_index * dim + value_index] = static_cast<CentroidValueType>(centroids[cluster_index][value_index]);
+            }
+        }
 
         // for each data
-        double cost(0);
-        for (std::size_t data_index = 0; data_index < dataset.size(); ++data_index)
+        std::vector<std::uint32_t> &nearest_list = m_labels.resetLabels(num_data, num_clusters);
+        std::vector<double> distance_list(num_data);
+        std::size_t num_changed_labels(0);
+        #pragma omp parallel
         {
-            // set target data
-            double min_squared_distance(std::numeric_limits<double>::max());
-            std::size_t nearest_cluster_index(0);
+            // 型変換はデータごとに1回だけ //
+            std::vector<CentroidValueType> target(dim);
 
-            // search nearest cluster (centroid)
-            for (std::size_t cluster_index = 0; cluster_index < centroids.size(); ++cluster_index)
+            #pragma omp for reduction(+:num_changed_labels)
+            for (std::size_t data_index = 0; data_index < num_data; ++data_index)
             {
-                // calc squared distance
-                double new_squared_distance = calcSquaredDistance(dataset.at(data_index), centroids.at(cluster_index));
+                // set target data
+                for (std::size_t value_index = 0; value_index < dim; ++value_index)
+                {
+                    target[value_index] = static_cast<CentroidValueType>(dataset[data_index][value_index]);
+                }
+                double min_squared_distance(std::numeric_limits<double>::max());
+                std::size_t nearest_cluster_index(0);
 
-                // update nearest cluster (centroid)
-                if (new_squared_distance < min_squared_distance)
+                // search nearest cluster (centroid)
+                for (std::size_t cluster_index = 0; cluster_index < num_clusters; ++cluster_index)
                 {
-                    min_squared_distance = new_squared_distance;
-                    nearest_cluster_index = cluster_index;
+                    // calc squared distance
+                    double new_squared_distance = calcSquaredDistance(target, &centroid_buffer[cluster_index * dim]);
+
+                    // update nearest cluster (centroid)
+                    if (new_squared_distance < min_squared_distance)
+                    {
+                        min_squared_distance = new_squared_distance;
+                        nearest_cluster_index = cluster_index;
+                    }
                 }
+                num_changed_labels += (nearest_list[data_index] != nearest_cluster_index) ? 1 : 0;
+                nearest_list[data_index] = static_cast<std::uint32_t>(nearest_cluster_index);
+                distance_list[data_index] = min_squared_distance;
             }
+        }
+        num_changed = num_changed_labels;
 
-            // asign data to nearest cluster
-            m_clusterid_to_dataids.at(nearest_cluster_index).push_back(data_index);
-            cost += min_squared_distance;
+        // sum cost
+        double cost(0.0);
+        for (std::size_t data_index = 0; data_index < num_data; ++data_index)
+        {
+            cost += sampleWeight(data_index) * distance_list[data_index];
         }
         return cost;
     }
     
 
-    template<class DataType>
-    void KMeans::calcCentroids(const std::vector<DataType> &dataset, std::vector< std::vector<double> > &centroids)
+    template<class Dataset>
+    double KMeans::updateLabelKdTree(const Dataset &dataset, const std::vector< std::vector<double> > &centroids, std::size_t &num_changed)
     {
+        typedef typename Dataset::value_type DataType;
+
         // set size data
-        const std::size_t cluster_size(m_clusterid_to_dataids.size());
         const std::size_t dim(m_dim);
-        centroids.resize(cluster_size, std::vector<double>(dim, 0.0));
+        const std::size_t num_data(dataset.size());
 
-        
-        // for each cluster
-        for (std::size_t cluster_index = 0; cluster_index < cluster_size; ++cluster_index)
+        // クラスタ重心の kd-tree (深さの上限はクラスタ数に対して十分大きくしておく) //
+        const scl::KdTree< std::vector<double> > tree(centroids, 64);
+
+        // search nearest cluster (centroid)
+        std::vector<std::uint32_t> &nearest_list = m_labels.resetLabels(num_data, centroids.size());
+        std::vector<double> distance_list(num_data);
+        std::size_t num_changed_labels(0);
+        #pragma omp parallel
         {
-            // num data in this cluster
-            std::size_t num_data = m_clusterid_to_dataids.at(cluster_index).size();
+            std::vector<double> query(dim);
 
-            // no data (error)
-            if (num_data == 0)
+            #pragma omp for reduction(+:num_changed_labels)
+            for (std::size_t data_index = 0; data_index < num_data; ++data_index)
             {
-                // set zero
-                std::vector<double> &centroid = centroids.at(cluster_index);
+                const DataType &target(dataset[data_index]);
                 for (std::size_t value_index = 0; value_index < dim; ++value_index)
                 {
-                    centroid[value_index] = 0;
+                    query[value_index] = static_cast<double>(target[value_index]);
                 }
+
+                double distance(0.0);
+                const std::uint32_t nearest_cluster_index = static_cast<std::uint32_t>(tree.nnSearch(query, distance));
+                num_changed_labels += (nearest_list[data_index] != nearest_cluster_index) ? 1 : 0;
+                nearest_list[data_index] = nearest_cluster_index;
+                distance_list[data_index] = distance * distance;
+            }
+        }
+        num_changed = num_changed_labels;
+
+        // sum cost
+        double cost(0.0);
+        for (std::size_t data_index = 0; data_index < num_data; ++data_index)
+        {
+            cost += sampleWeight(data_index) * distance_list[data_index];
+        }
+        return cost;
+    }
+
+
+    template<class Dataset>
+    double KMeans::updateLabelGemm(const Dataset &dataset, const std::vector< std::vector<double> > &centroids, std::size_t &num_changed)
+    {
+        typedef typename Dataset::value_type DataType;
+
+        // データに合わせた精度の行列 (float or 8bit 整数なら float) //
+        typedef typename internal::CentroidValueType<DataType>::type ValueType;
+        typedef Eigen::Matrix<ValueType, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> Matrix;
+        typedef Eigen::Matrix<ValueType, Eigen::Dynamic, 1> Vector;
+
+        // set size data
+        const std::size_t dim(m_dim);
+        const std::size_t num_data(dataset.size());
+        const std::size_t num_clusters(centroids.size());
+        const std::size_t tile_size(256);            // 1回の行列積で扱うデータ数 //
+        const std::size_t centroid_tile_size(512);   // 1回の行列積で扱うクラスタ数 //
+        const std::size_t num_tiles((num_data + tile_size - 1) / tile_size);
+
+        // クラスタ重心 (k x dim) とその2乗ノルム //
+        Matrix centroid_matrix(num_clusters, dim);
+        for (std::size_t cluster_index = 0; cluster_index < num_clusters; ++cluster_index)
+        {
+            for (std::size_t value_index = 0; value_index < dim; ++value_index)
+            {
+                centroid_matrix(cluster_index, value_index) = static_cast<ValueType>(centroids[cluster_index][value_index]);
             }
-            else
+        }
+        // KMeans::COSINE では重心が単位ベクトルなので ||c||^2 は除き、x・c の argmax にする //
+        const bool is_cosine(m_distance_type == KMeans::COSINE);
+        const Vector centroid_norms = is_cosine ? Vector(Vector::Zero(num_clusters)) : Vector(centroid_matrix.rowwise().squaredNorm());
+
+        // for each tile
+        std::vector<std::uint32_t> &nearest_list = m_labels.resetLabels(num_data, num_clusters);
+        std::vector<double> distance_list(num_data);
+        std::size_t num_changed_labels(0);
+        #pragma omp parallel
+        {
+            Matrix tile(tile_size, dim);
+            Matrix products(tile_size, std::min(centroid_tile_size, num_clusters));
+            Vector best_scores(tile_size);
+            std::vector<std::uint32_t> best_labels(tile_size);
+
+            #pragma omp for schedule(static) reduction(+:num_changed_labels)
+            for (std::size_t tile_index = 0; tile_index < num_tiles; ++tile_index)
             {
-                // sum value
-                double sum[dim] = { 0 };
+                const std::size_t begin(tile_index * tile_size);
+                const std::size_t rows(std::min(tile_size, num_data - begin));
 
-                // calc sum
-                for (std::size_t i = 0; i < num_data; ++i)
+                // set target data
+                for (std::size_t row = 0; row < rows; ++row)
                 {
-                    std::size_t data_index = m_clusterid_to_dataids.at(cluster_index).at(i);
-                    const DataType &target(dataset.at(data_index));
-                    
+                    const DataType &target(dataset[begin + row]);
                     for (std::size_t value_index = 0; value_index < dim; ++value_index)
                     {
-                        sum[value_index] += static_cast<double>(target[value_index]);
+                        tile(row, value_index) = static_cast<ValueType>(target[value_index]);
                     }
                 }
-                
-                // calc centroid
-                std::vector<double> &centroid(centroids.at(cluster_index));
-                double num = static_cast<double>(num_data);
-                
-                for (std::size_t value_index = 0; value_index < dim; ++value_index)
+                best_scores.head(rows).setConstant(std::numeric_limits<ValueType>::max());
+                std::fill(best_labels.begin(), best_labels.begin() + rows, 0);
+
+                // ||x - c||^2 = ||x||^2 - 2 x・c + ||c||^2 の最小 (||x||^2 は共通なので最後に足す) //
+                for (std::size_t centroid_begin = 0; centroid_begin < num_clusters; centroid_begin += centroid_tile_size)
+                {
+                    const std::size_t cols(std::min(centroid_tile_size, num_clusters - centroid_begin));
+                    products.topLeftCorner(rows, cols).noalias() = tile.topRows(rows) * centroid_matrix.middleRows(centroid_begin, cols).transpose();
+
+                    for (std::size_t row = 0; row < rows; ++row)
+                    {
+                        for (std::size_t col = 0; col < cols; ++col)
+                        {
+                            ValueType score = centroid_norms(centroid_begin + col) - 2 * products(row, col);
+                            if (score < best_scores(row))
+                            {
+                                best_scores(row) = score;
+                                best_labels[row] = static_cast<std::uint32_t>(centroid_begin + col);
+                            }
+                        }
+                    }
+                }
+
+                for (std::size_t row = 0; row < rows; ++row)
                 {
-                    centroid[value_index] = sum[value_index] / num;
+                    num_changed_labels += (nearest_list[begin + row] != best_labels[row]) ? 1 : 0;
+                    nearest_list[begin + row] = best_labels[row];
+
+                    double squared_distance = is_cosine
+                        ? 1.0 + 0.5 * static_cast<double>(best_scores(row)) * m_inverse_norms[begin + row]  // 1 - cos //
+                        : static_cast<double>(tile.row(row).squaredNorm() + best_scores(row));
+                    distance_list[begin + row] = std::max(0.0, squared_distance);
                 }
-            
-            }  // end : exist points
-        
-        }  // end : each cluster
-    
+            }
+        }
+        num_changed = num_changed_labels;
+
+        // sum cost
+        double cost(0.0);
+        for (std::size_t data_index = 0; data_index < num_data; ++data_index)
+        {
+            cost += sampleWeight(data_index) * distance_list[data_index];
+        }
+        return cost;
+    }
+
+
+    template<class Dataset>
+    double KMeans::updateLabelFiltering(const Dataset &dataset, const std::vector< std::vector<double> > &centroids, std::size_t &num_changed)
+    {
+        // set size data
+        const std::size_t num_data(dataset.size());
+        const std::size_t num_clusters(centroids.size());
+
+        // 根ノードの候補は全クラスタ //
+        std::vector<std::size_t> candidates(num_clusters);
+        std::iota(candidates.begin(), candidates.end(), 0);
+
+        std::vector<std::uint32_t> &nearest_list = m_labels.resetLabels(num_data, num_clusters);
+        num_changed = 0;
+        double cost = filterCandidates(dataset, centroids, 0, candidates, 0, num_clusters, nearest_list, num_changed);
+        return cost;
+    }
+
+
+    template<class Dataset>
+    void KMeans::buildFilteringTree(const Dataset &dataset)
+    {
+        m_filtering_nodes.clear();
+        m_filtering_indices.resize(dataset.size());
+        std::iota(m_filtering_indices.begin(), m_filtering_indices.end(), 0);
+
+        buildFilteringNode(dataset, 0, dataset.size());
+    }
+
+
+    template<class Dataset>
+    std::size_t KMeans::buildFilteringNode(const Dataset &dataset, const std::size_t begin, const std::size_t end)
+    {
+        typedef typename Dataset::value_type DataType;
+
+        // set size data
+        const std::size_t dim(m_dim);
+        const std::size_t leaf_size(8);
+
+        // 外接直方体と総和の計算 //
+        FilteringNode node;
+        node.begin = begin;
+        node.end = end;
+        node.child[0] = node.child[1] = 0;
+        node.lower.assign(dim, std::numeric_limits<double>::max());
+        node.upper.assign(dim, std::numeric_limits<double>::lowest());
+        node.sum.assign(dim, 0.0);
+        node.squared_norm_sum = 0.0;
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            const DataType &target(dataset[m_filtering_indices[i]]);
+            for (std::size_t value_index = 0; value_index < dim; ++value_index)
+            {
+                double value = static_cast<double>(target[value_index]);
+                node.lower[value_index] = std::min(node.lower[value_index], value);
+                node.upper[value_index] = std::max(node.upper[value_index], value);
+                node.sum[value_index] += value;
+                node.squared_norm_sum += (value * value);
+            }
+        }
+
+        // 最も幅の広い軸 //
+        std::size_t axis(0);
+        double max_width(0.0);
+        for (std::size_t value_index = 0; value_index < dim; ++value_index)
+        {
+            double width = node.upper[value_index] - node.lower[value_index];
+            if (width > max_width)
+            {
+                max_width = width;
+                axis = value_index;
+            }
+        }
+
+        const std::size_t node_index(m_filtering_nodes.size());
+        m_filtering_nodes.push_back(node);
+
+        // 葉 (データ数が少ない or 全データが同じ位置) //
+        if (end - begin <= leaf_size || max_width <= 0.0)
+        {
+            return node_index;
+        }
+
+        // 中央値で分割 //
+        const std::size_t mid((begin + end) / 2);
+        std::nth_element(m_filtering_indices.begin() + begin, m_filtering_indices.begin() + mid, m_filtering_indices.begin() + end,
+                         [&](std::size_t left, std::size_t right) { return static_cast<double>(dataset[left][axis]) < static_cast<double>(dataset[right][axis]); });
+
+        std::size_t lo = buildFilteringNode(dataset, begin, mid);
+        std::size_t hi = buildFilteringNode(dataset, mid, end);
+        m_filtering_nodes[node_index].child[0] = lo;
+        m_filtering_nodes[node_index].child[1] = hi;
+
+        return node_index;
+    }
+
+
+    template<class Dataset>
+    double KMeans::filterCandidates(const Dataset &dataset, const std::vector< std::vector<double> > &centroids, const std::size_t node_index,
+                                    std::vector<std::size_t> &candidates, const std::size_t offset, const std::size_t num_candidates, std::vector<std::uint32_t> &nearest_list,
+                                    std::size_t &num_changed) const
+    {
+        const FilteringNode &node(m_filtering_nodes[node_index]);
+        const std::size_t dim(m_dim);
+
+        // 葉 : 残った候補と総当たり //
+        if (node.child[0] == 0)
+        {
+            double cost(0.0);
+            for (std::size_t i = node.begin; i < node.end; ++i)
+            {
+                const std::size_t data_index(m_filtering_indices[i]);
+                double min_squared_distance(std::numeric_limits<double>::max());
+                std::size_t nearest_cluster_index(0);
+                for (std::size_t candidate_id = offset; candidate_id < offset + num_candidates; ++candidate_id)
+                {
+                    double squared_distance = calcSquaredDistance(dataset[data_index], centroids[candidates[candidate_id]]);
+                    if (squared_distance < min_squared_distance)
+                    {
+                        min_squared_distance = squared_distance;
+                        nearest_cluster_index = candidates[candidate_id];
+                    }
+                }
+                num_changed += (nearest_list[data_index] != nearest_cluster_index) ? 1 : 0;
+                nearest_list[data_index] = static_cast<std::uint32_t>(nearest_cluster_index);
+                cost += min_squared_distance;
+            }
+            return cost;
+        }
+
+        // 直方体の中心に最も近い候補 z* //
+        std::size_t best_candidate(candidates[offset]);
+        double best_squared_distance(std::numeric_limits<double>::max());
+        for (std::size_t candidate_id = offset; candidate_id < offset + num_candidates; ++candidate_id)
+        {
+            const std::vector<double> &centroid(centroids[candidates[candidate_id]]);
+            double squared_distance(0.0);
+            for (std::size_t value_index = 0; value_index < dim; ++value_index)
+            {
+                double value_error = centroid[value_index] - 0.5 * (node.lower[value_index] + node.upper[value_index]);
+                squared_distance += (value_error * value_error);
+            }
+            if (squared_distance < best_squared_distance)
+            {
+                best_squared_distance = squared_distance;
+                best_candidate = candidates[candidate_id];
+            }
+        }
+
+        // 直方体内のどこでも z* より遠い候補を除く //
+        // (z - z* の方向で最も z 側にある頂点で比較すれば十分) //
+        const std::size_t next_offset(offset + num_candidates);
+        if (candidates.size() < next_offset + num_candidates)
+        {
+            candidates.resize(next_offset + num_candidates);
+        }
+        std::size_t num_remains(0);
+        const std::vector<double> &best_centroid(centroids[best_candidate]);
+        for (std::size_t candidate_id = offset; candidate_id < offset + num_candidates; ++candidate_id)
+        {
+            const std::size_t cluster_index(candidates[candidate_id]);
+            const std::vector<double> &centroid(centroids[cluster_index]);
+            double squared_distance(0.0), best_squared_distance(0.0);
+            for (std::size_t value_index = 0; value_index < dim; ++value_index)
+            {
+                double vertex = (centroid[value_index] > best_centroid[value_index]) ? node.upper[value_index] : node.lower[value_index];
+                double value_error = centroid[value_index] - vertex;
+                double best_value_error = best_centroid[value_index] - vertex;
+                squared_distance += (value_error * value_error);
+                best_squared_distance += (best_value_error * best_value_error);
+            }
+            if (cluster_index == best_candidate || squared_distance < best_squared_distance)
+            {
+                candidates[next_offset + num_remains] = cluster_index;
+                ++num_remains;
+            }
+        }
+
+        // 候補が1つならノード内の全データを割り当てる //
+        if (num_remains == 1)
+        {
+            for (std::size_t i = node.begin; i < node.end; ++i)
+            {
+                const std::size_t data_index(m_filtering_indices[i]);
+                num_changed += (nearest_list[data_index] != best_candidate) ? 1 : 0;
+                nearest_list[data_index] = static_cast<std::uint32_t>(best_candidate);
+            }
+
+            // sum ||x - z||^2 = sum ||x||^2 - 2 z * sum x + n ||z||^2 //
+            double dot(0.0), squared_norm(0.0);
+            for (std::size_t value_index = 0; value_index < dim; ++value_index)
+            {
+                dot += best_centroid[value_index] * node.sum[value_index];
+                squared_norm += best_centroid[value_index] * best_centroid[value_index];
+            }
+            double num = static_cast<double>(node.end - node.begin);
+            return std::max(0.0, node.squared_norm_sum - 2.0 * dot + num * squared_norm);
+        }
+
+        // 子ノードへ //
+        const std::size_t lo(node.child[0]), hi(node.child[1]);
+        return ( filterCandidates(dataset, centroids, lo, candidates, next_offset, num_remains, nearest_list, num_changed)
+                 + filterCandidates(dataset, centroids, hi, candidates, next_offset, num_remains, nearest_list, num_changed) );
+    }
+
+
+    double KMeans::sampleWeight(const std::size_t data_index) const
+    {
+        return (m_weights == NULL) ? 1.0 : (*m_weights)[data_index];
+    }
+
+
+    template<class Dataset>
+    std::size_t KMeans::reseedEmptyClusters(const Dataset &dataset, std::vector< std::vector<double> > &centroids)
+    {
+        // KMeans::COSINE の重心は正規化したデータにする //
+        const bool is_cosine(m_distance_type == KMeans::COSINE);
+        return internal::reseedEmptyClusters(m_dim, dataset,
+                                             [&](const std::size_t data_index) { return sampleWeight(data_index); },
+                                             [&](const std::size_t data_index, const std::vector<double> &centroid) { return calcCentroidDistance(dataset, data_index, centroid); },
+                                             is_cosine ? &m_inverse_norms : NULL, m_labels.getMutableLabels(), centroids);
+    }
+
+
+    template<class Dataset>
+    double KMeans::calcInertia(const Dataset &dataset, const std::vector< std::vector<double> > &centroids) const
+    {
+        const std::vector<std::uint32_t> &labels(m_labels.getLabels());
+        return scl::parallel::sum(labels.size(), [&](const std::size_t data_index)
+        {
+            return sampleWeight(data_index) * calcCentroidDistance(dataset, data_index, centroids[labels[data_index]]);
+        });
+    }
+
+
+    template<class Dataset>
+    void KMeans::calcCentroids(const Dataset &dataset, std::vector< std::vector<double> > &centroids)
+    {
+        centroids.resize(m_labels.getNumClusters(), std::vector<double>(m_dim, 0.0));
+
+        // KMeans::COSINE は正規化したデータの和 //
+        const bool is_cosine(m_distance_type == KMeans::COSINE);
+        std::vector<double> weight_sums;
+        internal::sumCentroids(m_dim, dataset, m_labels.getLabels(),
+                               [&](const std::size_t data_index) { return is_cosine ? sampleWeight(data_index) * m_inverse_norms[data_index] : sampleWeight(data_index); },
+                               centroids, weight_sums);
+
+        // calc centroid (no data なら 0 のまま) //
+        if (is_cosine)
+        {
+            // 平均の向き = 和の向き //
+            normalizeCentroids(centroids);
+            return;
+        }
+        internal::averageCentroids(m_dim, weight_sums, centroids);
     }
     
 } // end of namespace scl
@@ -0,0 +1,308 @@
+/**
+ * @file StreamingKMeans.hpp
+ * @brief This class implements the online (streaming) k-means clustering algorithm.
+ */
+
+#ifndef SCL_STREAMING_K_MEANS_HPP
+#define SCL_STREAMING_K_MEANS_HPP
+
+#include <scl/clustering/KMeans.hpp>
+#include <vector>
+#include <limits>
+
+namespace scl
+{
+    /**
+     * @class StreamingKMeans
+     * @brief online (streaming) k-means clustering.
+     * @details バッチごとにクラスタ重心とデータ数だけを更新し、過去のデータは保持しない。
+     * 1データあたりの更新コストは O(k・dim) @n
+     * 参考 @n
+     * <a href="https://www.eecs.tufts.edu/~dsculley/papers/fastkmeans.pdf">Web-Scale K-Means Clustering | D. Sculley (2010)</a>
+     */
+    class StreamingKMeans
+    {
+    public:
+        /** @brief コンストラクタ */
+        StreamingKMeans();
+
+
+        /**
+         * @brief パラメータ設定
+         * @param[in] num_clusters クラスタ数
+         * @param[in] decay バッチごとに各クラスタのデータ数に掛ける減衰率 (0, 1]。1なら減衰しない
+         * @param[in] method 最初のバッチでのクラスタ重心の初期化方法 (KMeans::MANUAL 以外)
+         * @return method が KMeans::MANUAL なら何も設定せずに false
+         * @details 以前の重心から始めるなら StreamingKMeans::setCentroids を使う
+         */
+        bool setParameters(const std::size_t num_clusters, const double decay=1.0, const KMeans::InitMethod method=KMeans::PLUSPLUS);
+
+
+        /**
+         * @brief 乱数のシードを設定
+         * @see KMeans::setSeed
+         */
+        void setSeed(const std::uint64_t seed);
+
+
+        /**
+         * @brief 以前のモデルのクラスタ重心から開始する (KMeans::MANUAL 相当)
+         * @param[in] centroids 各クラスタの重心位置
+         * @param[in] counts 各クラスタのデータ数 (空なら全て1)
+         */
+        void setCentroids(const std::vector< std::vector<double> > &centroids, const std::vector<double> &counts=std::vector<double>());
+
+
+        /**
+         * @brief バッチを追加してクラスタ重心を更新
+         * @tparam DataType クラスタリングするデータの型
+         * @param[in] dim DataTypeの次数
+         * @param[in] batch 追加するデータ
+         * @return クラスタ数が0、次数が既存のクラスタ重心と違う、または最初のバッチでクラスタ重心を初期化できなければ false
+         * @details 最初のバッチ (クラスタ重心が未設定のとき) は k-means で初期化する。
+         * バッチ内は現在の重心で最近傍クラスタを並列に求めてから、データ順に重心を更新する
+         * @attention DataType needs [] access operator
+         */
+        template<class DataType>
+        bool partialFit(const std::size_t dim, const std::vector<DataType> &batch);
+
+
+        /**
+         * @brief 最近傍クラスタの取得
+         * @param[in] point 対象データ
+         * @return クラスタID
+         */
+        template<class DataType>
+        std::size_t predict(const DataType &point) const;
+
+
+        /** @brief 各クラスタの重心位置 */
+        const std::vector< std::vector<double> > & getCentroids() const;
+
+
+        /** @brief 各クラスタのデータ数 (減衰込み) */
+        const std::vector<double> & getCounts() const;
+
+
+    private:
+        /**
+         * @brief 最近傍クラスタ
+         * @param[out] squared_distance 最近傍クラスタ重心との距離の2乗
+         */
+        template<class DataType>
+        std::size_t findNearest(const DataType &point, double &squared_distance) const;
+
+
+        /** @brief クラスタリングするデータの次数 */
+        std::size_t m_dim;
+
+
+        /** @brief クラスタ数 */
+        std::size_t m_num_clusters;
+
+
+        /** @brief バッチごとの減衰率 */
+        double m_decay;
+
+
+        /** @brief 最初のバッチでの初期化方法 */
+        KMeans::InitMethod m_method;
+
+
+        /** @brief 各クラスタの重心位置 */
+        std::vector< std::vector<double> > m_centroids;
+
+
+        /** @brief 各クラスタのデータ数 (減衰込み) */
+        std::vector<double> m_counts;
+
+
+        /** @brief 最初のバッチの初期化に使う k-means */
+        KMeans m_kmeans;
+        
+    };  // end of streaming k-means class
+
+
+
+
+    //------------------------------------------------------------------
+    // 実装部
+    //------------------------------------------------------------------
+
+    StreamingKMeans::StreamingKMeans()
+        : m_dim(0),
+          m_num_clusters(1),
+          m_decay(1.0),
+          m_method(KMeans::PLUSPLUS)
+    {
+    }
+
+
+    bool StreamingKMeans::setParameters(const std::size_t num_clusters, const double decay, const KMeans::InitMethod method)
+    {
+        if (method == KMeans::MANUAL)
+        {
+            return false;
+        }
+
+        m_num_clusters = num_clusters;
+        m_decay = decay;
+        m_method = method;
+        return true;
+    }
+
+
+    void StreamingKMeans::setSeed(const std::uint64_t seed)
+    {
+        m_kmeans.setSeed(seed);
+    }
+
+
+    void StreamingKMeans::setCentroids(const std::vector< std::vector<double> > &centroids, const std::vector<double> &counts)
+    {
+        m_centroids = centroids;
+        m_num_clusters = centroids.size();
+        m_dim = centroids.empty() ? 0 : centroids.front().size();
+
+        m_counts.assign(m_num_clusters, 1.0);
+        if (counts.size() == m_num_clusters)
+        {
+            m_counts = counts;
+        }
+    }
+
+
+    template<class DataType>
+    bool StreamingKMeans::partialFit(const std::size_t dim, const std::vector<DataType> &batch)
+    {
+        // size check
+        if (m_num_clusters == 0 || ( !m_centroids.empty() && dim != m_centroids.front().size()))
+        {
+            return false;
+        }
+        if (dim == 0 || batch.empty())
+        {
+            return true;
+        }
+        m_dim = dim;
+        std::size_t first_index(0);
+
+
+        // 最初のバッチ : k-means で初期化 //
+        if (m_centroids.size() < m_num_clusters)
+        {
+            if (m_centroids.empty() && batch.size() >= m_num_clusters)
+            {
+                // 収束しなくても重心は使えるので、重心が揃わなかったときだけ失敗 //
+                const bool is_converged = m_kmeans.clustering(dim, batch, m_num_clusters, m_centroids, m_method);
+                if ( !is_converged && m_centroids.size() != m_num_clusters)
+                {
+                    m_centroids.clear();
+                    m_counts.clear();
+                    return false;
+                }
+
+                m_counts.resize(m_num_clusters);
+                for (std::size_t cluster_index = 0; cluster_index < m_num_clusters; ++cluster_index)
+                {
+                    m_counts[cluster_index] = static_cast<double>(m_kmeans.getClusterLabels().getClusterSize(cluster_index));
+                }
+                return true;
+            }
+
+            // データがクラスタ数より少ない場合はそのまま重心にする //
+            for (; first_index < batch.size() && m_centroids.size() < m_num_clusters; ++first_index)
+            {
+                std::vector<double> centroid(dim, 0.0);
+                for (std::size_t value_index = 0; value_index < dim; ++value_index)
+                {
+                    centroid[value_index] = static_cast<double>(batch[first_index][value_index]);
+                }
+                m_centroids.push_back(centroid);
+                m_counts.push_back(1.0);
+            }
+        }
+
+
+        // decay
+        for (std::size_t cluster_index = 0; cluster_index < m_counts.size(); ++cluster_index)
+        {
+            m_counts[cluster_index] *= m_decay;
+        }
+
+
+        // 最近傍クラスタ (バッチ開始時の重心で並列に計算) //
+        const std::size_t num_data(batch.size());
+        std::vector<std::size_t> nearest_list(num_data, 0);
+        #pragma omp parallel for
+        for (std::size_t data_index = first_index; data_index < num_data; ++data_index)
+        {
+            double squared_distance(0.0);
+            nearest_list[data_index] = findNearest(batch[data_index], squared_distance);
+        }
+
+
+        // 重心の更新 (学習率 = 1 / クラスタのデータ数) //
+        for (std::size_t data_index = first_index; data_index < num_data; ++data_index)
+        {
+            const std::size_t cluster_index(nearest_list[data_index]);
+            std::vector<double> &centroid(m_centroids[cluster_index]);
+            m_counts[cluster_index] += 1.0;
+
+            const double rate = 1.0 / m_counts[cluster_index];
+            for (std::size_t value_index = 0; value_index < dim; ++value_index)
+            {
+                centroid[value_index] += rate * (static_cast<double>(batch[data_index][value_index]) - centroid[value_index]);
+            }
+        }
+        return true;
+    }
+
+
+    template<class DataType>
+    std::size_t StreamingKMeans::predict(const DataType &point) const
+    {
+        double squared_distance(0.0);
+        return findNearest(point, squared_distance);
+    }
+
+
+    const std::vector< std::vector<double> >& StreamingKMeans::getCentroids() const
+    {
+        return m_centroids;
+    }
+
+
+    const std::vector<double>& StreamingKMeans::getCounts() const
+    {
+        return m_counts;
+    }
+
+
+    template<class DataType>
+    std::size_t StreamingKMeans::findNearest(const DataType &point, double &squared_distance) const
+    {
+        std::size_t nearest_cluster_index(0);
+        squared_distance = std::numeric_limits<double>::max();
+        for (std::size_t cluster_index = 0; cluster_index < m_centroids.size(); ++cluster_index)
+        {
+            const std::vector<double> &centroid(m_centroids[cluster_index]);
+            double new_squared_distance(0.0);
+            for (std::size_t value_index = 0; value_index < m_dim; ++value_index)
+            {
+                const double error = static_cast<double>(point[value_index]) - centroid[value_index];
+                new_squared_distance += error * error;
+            }
+            if (new_squared_distance < squared_distance)
+            {
+                squared_distance = new_squared_distance;
+                nearest_cluster_index = cluster_index;
+            }
+        }
+        return nearest_cluster_index;
+    }
+    
+} // end of namespace scl
+
+
+#endif  /* SCL_STREAMING_K_MEANS_HPP */
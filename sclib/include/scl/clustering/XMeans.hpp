@@ -8,8 +8,12 @@
 #include <scl/clustering/KMeans.hpp>
 #include <scl/util/Statistics.hpp>
 #include <scl/util/EigenUtil.hpp>
+#include <scl/util/Parallel.hpp>
+#include <scl/util/Random.hpp>
 #include <vector>
 #include <limits>
+#include <algorithm>  // copy, sort, min, max, push_heap
+#include <utility>    // pair, make_pair
 
 #include <iostream>
 
@@ -22,7 +26,9 @@ namespace scl
      * <a href="http://www.cs.cmu.edu/%7Edpelleg/download/xmeans.pdf">X-means: Extending K-means with Efficient Estimation of the Number of Clusters | Carnegie Mellon Univ. (2000)</a> @n
      * <a href="http://www.rd.dnc.ac.jp/%7Etunenori/doc/xmeans_euc.pdf">クラスター数を自動決定するk-meansアルゴリズムの拡張について | 大学入試センター 研究開発部 (2000)</a>
      * @details 参考サイト @n
-     * <a href="https://qiita.com/deaikei/items/8615362d320c76e2ce0b">qiita</a>
+     * <a href="https://qiita.com/deaikei/items/8615362d320c76e2ce0b">qiita</a> @n
+     * 各クラスタの分割判定は互いに独立なので OpenMP の task で並列に行う。
+     * 分割ごとの k-means のシードは親のシードから決まり、結果は直列に再帰したときと同じ順に並べるので、スレッド数によらず同じ結果になる
      */
     class XMeans
     {
@@ -35,7 +41,8 @@ namespace scl
         {
             BIC_ORG,      /**< Bayesian information criterion (pyclusteringを参考にした手法) */
             BIC_ISHIOKA,  /**< Bayesian information criterion (石岡の手法) */
-            MNDL          /**< Minimum noiseless description length */
+            MNDL,         /**< Minimum noiseless description length (pyclusteringを参考にした手法) */
+            ANDERSON_DARLING  /**< 分割軸に射影したデータの Anderson-Darling 検定 (G-means) */
         };
 
         
@@ -53,6 +60,40 @@ namespace scl
 
         /** @brief 分割時の評価方法を設定 */
         void setSplittingType(const SplittingType splitting_type);
+
+
+        /**
+         * @brief XMeans::ANDERSON_DARLING のパラメータ設定
+         * @param[in] critical_value 補正後の統計量 \f$ A^{*2} = A^2 (1 + 4/n - 25/n^2) \f$ がこれより大きければ分割する
+         *            (デフォルト 1.8692、有意水準 0.0001)
+         * @param[in] max_sort_size データ数 (重みの和ではない) がこれより多いクラスタはソートせずに近似する (デフォルト 65536)
+         * @see scl::normal::calcAndersonDarling, scl::normal::approximateAndersonDarling
+         */
+        void setAndersonDarlingParameters(const double critical_value=1.8692, const std::size_t max_sort_size=65536);
+
+
+        /**
+         * @brief クラスタ数の上限を設定
+         * @param[in] max_num_clusters 最大クラスタ数 (0 なら上限なし、デフォルト 0)
+         * @details 上限があるときは、評価値 (BIC) の改善量が大きい分割から順に上限まで行う (best-first)。
+         * 上限に届かなければ上限なしと同じ結果になる。初期クラスタ数も上限までにする
+         */
+        void setMaxNumClusters(const std::size_t max_num_clusters);
+
+
+        /**
+         * @brief 分割後に全データで k-means をやり直すか設定 (デフォルト false)
+         * @details 分割で確定した重心を初期値 ( KMeans::MANUAL ) にして全データをクラスタリングし直す。
+         * 局所的な分割だけでは直せないクラスタ境界を修正する
+         */
+        void setRefinement(const bool is_refined);
+
+
+        /**
+         * @brief 乱数のシードを設定
+         * @see KMeans::setSeed
+         */
+        void setSeed(const std::uint64_t seed);
         
 
         /**
@@ -60,7 +101,7 @@ namespace scl
          * @tparam DataType クラスタリングするデータの型
          * @param[in] dim DataTypeの次数
          * @param[in] dataset クラスタリングするデータセット
-         * @param[in] init_num_clusters 初期クラスタ数
+         * @param[in] init_num_clusters 初期クラスタ数 (XMeans::setMaxNumClusters の上限より多ければ上限にする)
          * @param[in,out] centroids 各クラスタの重心位置 ( method が KMeans::MANUAL の時だけ[in]も使う)
          * @param[in] min_num 各クラスタ内の最小データ数
          * @attention DataType needs [] access operator
@@ -69,259 +110,1463 @@ namespace scl
         void clustering(const std::size_t dim, const std::vector<DataType> &dataset, const std::size_t init_num_clusters, std::vector< std::vector<double> > &centroids, const std::size_t min_num=5);
 
 
-        /** 
-         * @brief 全クラスタの情報取得
-         * @see KMeans::m_clusterid_to_dataids
-         */
-        const std::vector< std::vector<std::size_t> > & getClusters() const;
+        /**
+         * @brief 重み付きデータのクラスタリング
+         * @details 重み w のデータは w 個の同じデータとして扱う (coreset をそのまま使える)。
+         * k-means、BIC、最小データ数の判定が重み付きになる
+         * @param[in] weights 各データの重み (dataset と同じサイズ、正の値)
+         * @see XMeans::clustering
+         */
+        template<class DataType>
+        void clustering(const std::size_t dim, const std::vector<DataType> &dataset, const std::vector<double> &weights,
+                        const std::size_t init_num_clusters, std::vector< std::vector<double> > &centroids, const std::size_t min_num=5);
+
+
+        /**
+         * @brief 前回の結果に追加データを反映する (incremental x-means)
+         * @tparam DataType クラスタリングするデータの型
+         * @param[in] dim DataTypeの次数
+         * @param[in] dataset 前回のデータの後ろに追加データを並べたデータセット
+         * @param[in] num_old_data 前回のクラスタリング (または更新) のデータ数
+         * @param[out] centroids 各クラスタの重心位置
+         * @param[in] min_num 各クラスタ内の最小データ数
+         * @details 追加データを最も近いクラスタに割り当てて、各クラスタの十分統計量を更新する。
+         * 重みの和が前回の判定時から XMeans::setUpdateRatio の割合以上増えたクラスタだけを判定し直す。 @n
+         * 判定し直すクラスタは、まず最も近いクラスタとの統合を十分統計量だけで評価する
+         * (初期クラスタ数より少なくはしない。 XMeans::ANDERSON_DARLING では統合しない)。
+         * 統合しなければ、そのクラスタのデータだけで x-means の分割をやり直す。
+         * 他のクラスタのラベルと統計量はそのまま使う @n
+         * 前回の結果と次数やデータ数が合わなければ何もしない。
+         * 全データでの k-means のやり直し (XMeans::setRefinement) は行わない
+         * @attention 評価方法 (XMeans::setSplittingType) は前回と同じにすること
+         */
+        template<class DataType>
+        void update(const std::size_t dim, const std::vector<DataType> &dataset, const std::size_t num_old_data, std::vector< std::vector<double> > &centroids, const std::size_t min_num=5);
+
+
+        /**
+         * @brief 重み付きデータの更新
+         * @param[in] weights 各データの重み (dataset と同じサイズ、前回の分も含む)
+         * @see XMeans::update
+         */
+        template<class DataType>
+        void update(const std::size_t dim, const std::vector<DataType> &dataset, const std::vector<double> &weights,
+                    const std::size_t num_old_data, std::vector< std::vector<double> > &centroids, const std::size_t min_num=5);
+
+
+        /**
+         * @brief 更新時に判定し直すクラスタの条件を設定
+         * @param[in] update_ratio 前回の判定時からの重みの和の増加率 (デフォルト 0.1)
+         * @see XMeans::update
+         */
+        void setUpdateRatio(const double update_ratio);
+
+
+        /**
+         * @brief 全クラスタの情報取得
+         * @see ClusterLabels::getClusters
+         */
+        const std::vector< std::vector<std::size_t> > & getClusters() const;
+
+
+        /**
+         * @brief 指定したクラスタの情報取得
+         * @see ClusterLabels::getCluster
+         */
+        const std::vector<std::size_t> & getCluster(const std::size_t cluster_id) const;
+
+
+        /** @brief 各データのクラスタID */
+        const std::vector<std::uint32_t> & getLabels() const;
+
+
+        /**
+         * @brief クラスタリング結果 (ラベル配列と CSR 形式のクラスタごとのデータ)
+         * @see ClusterLabels
+         */
+        const ClusterLabels & getClusterLabels() const;
+
+        
+    private:
+        /**
+         * @struct Candidate
+         * @brief 分割予定のクラスタ
+         */
+        struct Candidate
+        {
+            std::size_t begin;              /**< XMeans::m_order での先頭 */
+            std::size_t end;                /**< XMeans::m_order での末尾の次 */
+            std::vector<double> centroid;   /**< 重心 */
+            std::uint64_t seed;             /**< 分割に使う k-means のシード */
+        };
+
+
+        /**
+         * @struct Split
+         * @brief 評価済みの分割 (クラスタ数に上限があるときに使う)
+         */
+        struct Split
+        {
+            Candidate parent;       /**< 分割前のクラスタ */
+            Candidate children[2];  /**< 分割後のクラスタ */
+            double gain;            /**< 分割による評価値の改善量 */
+        };
+
+
+        /**
+         * @struct Workspace
+         * @brief スレッドごとの作業領域
+         */
+        struct Workspace
+        {
+            KMeans kmeans;                              /**< 分割に使う k-means (XMeans::m_kmeans のコピー) */
+            std::vector<std::size_t> partition_buffer;  /**< XMeans::partitionByLabels の作業領域 */
+            std::vector<double> range_weights;          /**< 分割中のクラスタの重み (k-means に渡す) */
+            std::vector< std::pair<double, double> > projections;  /**< 分割軸に射影した値と重み (XMeans::ANDERSON_DARLING) */
+            std::vector<double> histogram;              /**< Anderson-Darling 統計量の近似の作業領域 */
+        };
+
+
+        /**
+         * @struct ClusterStatistics
+         * @brief クラスタの十分統計量
+         * @details 桁落ちしないよう基準点からの差 \f$ d = x - reference \f$ で持つ。
+         * 同じ基準点の統計量は足し合わせられる
+         */
+        struct ClusterStatistics
+        {
+            Eigen::VectorXd reference;  /**< 基準点 (分割前のクラスタの重心) */
+            double weight;              /**< 重みの和 \f$ \Sigma w \f$ (重みなしならデータ数) */
+            Eigen::VectorXd sum;        /**< \f$ \Sigma w d \f$ */
+            double squared_sum;         /**< \f$ \Sigma w |d|^2 \f$ */
+            Eigen::MatrixXd scatter;    /**< \f$ \Sigma w d d^T \f$ (XMeans::BIC_ISHIOKA のときだけ) */
+        };
+
+
+        /**
+         * @brief split data (x-means main algorithm)
+         * @details 分割したら子クラスタごとに task を作って再帰する。分割しなければクラスタを確定する
+         * @param[in] dataset クラスタリングする全データ
+         * @param[in] candidate 分割予定のクラスタ
+         * @param[in] min_num クラスタ内の最小データ数 (これ以下なら分割しない)
+         */
+        template<class DataType>
+        void recursivelySplit(const std::vector<DataType> &dataset, const Candidate &candidate, const std::size_t min_num);
+
+
+        /**
+         * @brief 分割候補を x-means で分割し、確定したクラスタを XMeans::m_leaves に m_order での位置の順に並べる
+         * @param[in] dataset クラスタリングする全データ
+         * @param[in,out] candidates 分割候補 (作業に使うので中身は変わる)
+         * @param[in] min_num クラスタ内の最小データ数
+         * @param[in] num_fixed_clusters 分割候補以外の確定済みのクラスタ数 (クラスタ数の上限に含める)
+         */
+        template<class DataType>
+        void splitCandidates(const std::vector<DataType> &dataset, std::vector<Candidate> &candidates, const std::size_t min_num, const std::size_t num_fixed_clusters);
+
+
+        /**
+         * @brief クラスタ数の上限まで、評価値の改善量が大きい分割から順に行う
+         * @param[in] dataset クラスタリングする全データ
+         * @param[in] candidates 分割候補
+         * @param[in] min_num クラスタ内の最小データ数
+         * @param[in] num_fixed_clusters 分割候補以外の確定済みのクラスタ数
+         */
+        template<class DataType>
+        void splitBestFirst(const std::vector<DataType> &dataset, const std::vector<Candidate> &candidates, const std::size_t min_num, const std::size_t num_fixed_clusters);
+
+
+        /**
+         * @brief 1つのクラスタの分割判定
+         * @details 分割予定のクラスタは XMeans::m_order の [begin, end) 。
+         * 分割するときはこの範囲をその場で子クラスタごとに並べ替えるので、データのコピーは作らない
+         * @param[in,out] workspace 実行中のスレッドの作業領域
+         * @param[in] dataset クラスタリングする全データ
+         * @param[in] candidate 分割予定のクラスタ
+         * @param[in] min_num クラスタ内の最小データ数
+         * @param[out] children 分割後の2つのクラスタ
+         * @param[out] gain 分割による評価値の改善量 (分割したときだけ)
+         * @return 分割したか
+         */
+        template<class DataType>
+        bool splitCluster(Workspace &workspace, const std::vector<DataType> &dataset, const Candidate &candidate, const std::size_t min_num, Candidate *children, double &gain);
+
+
+        /**
+         * @brief 分割しないクラスタを確定する (複数スレッドから呼ばれる)
+         * @see XMeans::recursivelySplit
+         */
+        void addCluster(const Candidate &candidate);
+
+
+        /**
+         * @brief XMeans::m_order の候補の範囲を k-means のラベル 0, 1 の順に並べ替える (各ラベル内の順番は保つ)
+         * @details 並べ替えと同じ走査で2つの子クラスタの十分統計量を集計する (基準点は候補の重心)
+         * @param[out] statistics 子クラスタの十分統計量 (2つ)
+         * @return ラベル 1 の先頭
+         */
+        template<class DataType>
+        std::size_t partitionByLabels(Workspace &workspace, const std::vector<DataType> &dataset, const Candidate &candidate, ClusterStatistics *statistics);
+
+
+        /**
+         * @brief 分割の評価値を比べる
+         * @param[in] current_statistics 分割前のクラスタの十分統計量 (1つ)
+         * @param[in] current_centroids 分割前のクラスタの重心 (1つ)
+         * @param[in] split_statistics 分割後のクラスタの十分統計量 (2つ)
+         * @param[in] split_centroids 分割後のクラスタの重心 (2つ)
+         * @param[out] gain 分割による評価値の改善量 (分割したほうが良いときだけ)
+         * @return 分割したほうが良いか (XMeans::ANDERSON_DARLING は十分統計量だけでは判定できないので常に true)
+         */
+        bool isSplitBetter(const std::vector<ClusterStatistics> &current_statistics, const std::vector<std::vector<double> > &current_centroids,
+                           const std::vector<ClusterStatistics> &split_statistics, const std::vector<std::vector<double> > &split_centroids, double &gain) const;
+
+
+        /**
+         * @brief 分割軸に射影したデータの Anderson-Darling 統計量 (G-means)
+         * @details XMeans::m_order の候補の範囲を2つの子クラスタの重心を結ぶ軸に射影し、標準化して正規分布と比べる。
+         * データ数が XMeans::m_max_sort_size 以下ならソートして O(n log n)、
+         * それより多ければビンあたり平均16データのヒストグラムで O(n) で近似する
+         * @param[in] split_centroids 分割後の2つの重心
+         * @return 補正後の統計量 \f$ A^{*2} \f$ (射影した値が全て同じなら 0)
+         */
+        template<class DataType>
+        double calcAndersonDarling(Workspace &workspace, const std::vector<DataType> &dataset, const Candidate &candidate, const std::vector<std::vector<double> > &split_centroids) const;
+
+
+        /**
+         * @brief 基準点を設定して十分統計量を0にする
+         * @details 散布行列は XMeans::BIC_ISHIOKA のときだけ持つ
+         */
+        void resetStatistics(const Eigen::VectorXd &reference, ClusterStatistics &statistics) const;
+
+
+        /**
+         * @brief 十分統計量に1つのデータを足す
+         * @details 散布行列は下三角だけ更新するので、足し終わったら XMeans::completeScatter を呼ぶ
+         * @param[in,out] diff 作業領域 (サイズ m_dim)
+         */
+        template<class DataType>
+        void addStatistics(const DataType &point, const double weight, ClusterStatistics &statistics, Eigen::VectorXd &diff) const;
+
+
+        /** @brief 散布行列の上三角を下三角からコピーする */
+        void completeScatter(ClusterStatistics &statistics) const;
+
+
+        /**
+         * @brief 十分統計量を足し合わせる
+         * @details other の基準点を statistics の基準点に移してから足す
+         */
+        void mergeStatistics(ClusterStatistics &statistics, const ClusterStatistics &other) const;
+
+
+        /** @brief 十分統計量から重み付き平均 (重心) を求める */
+        std::vector<double> calcMean(const ClusterStatistics &statistics) const;
+
+
+        /**
+         * @brief XMeans::m_order の [begin, end) の十分統計量
+         * @param[in] reference 基準点
+         */
+        template<class DataType>
+        void calcStatistics(const std::vector<DataType> &dataset, const std::size_t begin, const std::size_t end,
+                            const std::vector<double> &reference, ClusterStatistics &statistics) const;
+
+
+        /**
+         * @brief 確定したクラスタごとの十分統計量を作る
+         * @details clustering 後の最初の XMeans::update で呼ぶ (更新しないなら作らない)。基準点は各クラスタの重心
+         * @param[in] dataset 前回のデータが先頭に並んだデータセット
+         */
+        template<class DataType>
+        void setClusterStatistics(const std::vector<DataType> &dataset);
+
+
+        /** @brief 重心が最も近いクラスタ */
+        template<class DataType>
+        std::size_t findNearestCluster(const DataType &point) const;
+
+
+        /** @brief スレッドごとの作業領域の準備 */
+        void resetWorkspaces();
+
+
+        /**
+         * @brief 重心からの重み付き二乗誤差の和 \f$ \Sigma w |x - centroid|^2 \f$
+         * @details 十分統計量から O(次元数) で求める
+         */
+        double calcSquaredError(const ClusterStatistics &statistics, const std::vector<double> &centroid) const;
+
+
+        /**
+         * @brief 十分統計量から共分散行列 (不偏推定量) を求める
+         * @see scl::calcCovariance
+         */
+        Eigen::MatrixXd calcCovariance(const ClusterStatistics &statistics) const;
+
+
+        /**
+         * @brief 十分統計量から対数尤度 \f$ \Sigma w log(pdf) \f$ を求める
+         * @details 共分散行列は不偏推定量、平均は mean の正規分布。データ数によらない
+         * @see scl::normal::calcLogLikelihood
+         */
+        double calcLogLikelihood(const ClusterStatistics &statistics, const std::vector<double> &mean) const;
+
+
+        /**
+         * @brief Bayesian information criterion, BIC
+         * @details pyclustering を参考にした @n
+         * <a href="https://github.com/annoviko/pyclustering">GitHub</a> @n
+         * 各クラスタの十分統計量から求めるので、データ数によらない
+         * @bug たまに結果がよろしくない。
+         *      分割するときのスコアを0.95倍にすると割といい感じ。
+         */
+        double bayesianInformationCriterion(const std::vector<ClusterStatistics> &statistics, const std::vector<std::vector<double> > &centroids) const;
+
+        
+        /**
+         * @brief Bayesian information criterion, BIC
+         * @details 論文の石岡の手法 @n
+         * <a href="https://web-salad.hateblo.jp/entry/2014/07/19/200347">参考ブログ</a> @n
+         * <a href="https://gist.github.com/yasaichi/254a060eff56a3b3b858#file-x_means-py">↑のGist</a> @n
+         * 各クラスタの十分統計量から求めるので、データ数によらない
+         * @bug あまり結果がよろしくない・・・移植ミス？
+         */
+        double bayesianInformationCriterionIshioka(const std::vector<ClusterStatistics> &statistics, const std::vector<std::vector<double> > &centroids) const;
+
+
+        /**
+         * @brief XMeans::m_order の [begin, end) の重みの和
+         * @details 重みなしならデータ数を返す
+         */
+        double sumWeights(const std::size_t begin, const std::size_t end) const;
+
+
+        /**
+         * @brief XMeans::m_order の [begin, end) が分割するには小さすぎるクラスタか
+         * @details 重みの和が min_num 未満なら小さすぎる。
+         * 重み付きの場合は共分散行列が正則になるよう、データ点が次元数以下のときも小さすぎるとする
+         */
+        bool isTooSmall(const std::size_t begin, const std::size_t end, const std::size_t min_num) const;
+
+
+        /**
+         * @brief Minimum noiseless description length, MNDL
+         * @details pyclustering を参考にした (alpha = beta = 0.9) @n
+         * <a href="https://github.com/annoviko/pyclustering">GitHub</a> @n
+         * 各クラスタの十分統計量 (重みの和と二乗誤差) から求めるので、データ数によらない。 @n
+         * 雑音の分散はモデルごとに推定せず、比べる2つのモデルで同じ値を使う。
+         * 二乗誤差から各モデルで推定すると K = 1 では \f$ W = K_w \f$ になり、分割前が必ず有利になるため
+         * @note 各クラスタの平均二乗誤差の和 \f$ W \f$ が分割でおよそ半分にならないと分割しないので、
+         * 重なりの大きいクラスタは BIC より分割しにくい
+         * @param[in] squared_sigma 雑音の分散 (XMeans::estimateNoiseVariance)
+         */
+        double minimumNoiselessDescriptionLength(const std::vector<ClusterStatistics> &statistics, const std::vector<std::vector<double> > &centroids,
+                                                 const double squared_sigma) const;
+
+
+        /**
+         * @brief MNDL で使う雑音の分散 \f$ \Sigma W_i / (N - K) \f$
+         * @details 分割を評価するときは分割後 (細かい方) のモデルから推定する
+         * @return 推定できなければ (データ数がクラスタ数以下、空のクラスタ) 負の値
+         */
+        double estimateNoiseVariance(const std::vector<ClusterStatistics> &statistics, const std::vector<std::vector<double> > &centroids) const;
+
+        
+        /** @brief クラスタリングするデータの次数 */
+        std::size_t m_dim;
+
+
+        /** @brief データの並べ替え配列 (分割中のクラスタのデータは連続した範囲になる) */
+        std::vector<std::size_t> m_order;
+
+
+        /** @brief 分割中に確定したクラスタ (クラスタリング後は XMeans::m_labels に移す) */
+        std::vector<Candidate> m_leaves;
+
+
+        /** @brief スレッドごとの作業領域 (クラスタリング中だけ有効) */
+        std::vector<Workspace> m_workspaces;
+
+
+        /** @brief x-means で確定したクラスタ情報 */
+        ClusterLabels m_labels;
+
+
+        /** @brief x-means で確定したクラスタの各重心 */
+        std::vector< std::vector<double> > m_centroids;
+                
+        
+        /** @brief k-means class (パラメータの保持用。実行は XMeans::Workspace のコピーで行う) */
+        scl::KMeans m_kmeans;
+
+
+        /** @brief 乱数のシード */
+        std::uint64_t m_seed;
+
+        
+        /** @brief k-means method */
+        KMeans::InitMethod m_method;
+
+
+        /** @brief 分割時の評価方法 */
+        SplittingType m_splitting_type;
+
+
+        /** @brief XMeans::ANDERSON_DARLING の臨界値 */
+        double m_critical_value;
+
+
+        /** @brief XMeans::ANDERSON_DARLING でソートする最大データ数 */
+        std::size_t m_max_sort_size;
+
+
+        /** @brief 最大クラスタ数 (0 なら上限なし) */
+        std::size_t m_max_num_clusters;
+
+
+        /** @brief 分割後に全データで k-means をやり直すか */
+        bool m_is_refined;
+
+
+        /** @brief 各データの重み (重みなしなら NULL、クラスタリング中だけ有効) */
+        const std::vector<double> *m_weights;
+
+
+        /** @brief 確定したクラスタごとの十分統計量 (基準点は確定したときの重心、 clustering 後の最初の更新までは空) */
+        std::vector<ClusterStatistics> m_statistics;
+
+
+        /** @brief 各クラスタを最後に判定したときの重みの和 */
+        std::vector<double> m_evaluated_weights;
+
+
+        /** @brief 更新時に判定し直す重みの和の増加率 */
+        double m_update_ratio;
+
+
+        /** @brief 前回のクラスタリングからの更新回数 (更新ごとの k-means のシードに使う) */
+        std::size_t m_num_updates;
+
+
+        /** @brief 前回のクラスタリングの初期クラスタ数 (更新時の統合の下限) */
+        std::size_t m_init_num_clusters;
+
+    };  // end of x-means class
+
+
+
+
+    //------------------------------------------------------------------
+    // 実装部
+    //------------------------------------------------------------------
+
+    XMeans::XMeans()
+        : m_seed(scl::rng::randomSeed()),
+          m_method(KMeans::PLUSPLUS),
+          m_splitting_type(XMeans::BIC_ORG),
+          m_critical_value(1.8692),
+          m_max_sort_size(65536),
+          m_max_num_clusters(0),
+          m_is_refined(false),
+          m_weights(NULL),
+          m_update_ratio(0.1),
+          m_num_updates(0),
+          m_init_num_clusters(0)
+    {
+    }
+    
+    
+    void XMeans::setParameters(const std::size_t max_iteration, const double tolerance, const std::size_t max_pp_trial, const KMeans::InitMethod method)
+    {
+        m_kmeans.setParameters(max_iteration, tolerance, max_pp_trial);
+        m_method = method;
+    }
+
+
+    void XMeans::setSplittingType(const SplittingType splitting_type)
+    {
+        m_splitting_type = splitting_type;
+    }
+
+
+    void XMeans::setAndersonDarlingParameters(const double critical_value, const std::size_t max_sort_size)
+    {
+        m_critical_value = critical_value;
+        m_max_sort_size = max_sort_size;
+    }
+
+
+    void XMeans::setMaxNumClusters(const std::size_t max_num_clusters)
+    {
+        m_max_num_clusters = max_num_clusters;
+    }
+
+
+    void XMeans::setRefinement(const bool is_refined)
+    {
+        m_is_refined = is_refined;
+    }
+
+
+    void XMeans::setSeed(const std::uint64_t seed)
+    {
+        m_seed = seed;
+    }
+
+
+    void XMeans::setUpdateRatio(const double update_ratio)
+    {
+        m_update_ratio = update_ratio;
+    }
+
+
+    void XMeans::resetWorkspaces()
+    {
+        m_workspaces.assign(scl::parallel::maxThreads(), Workspace());
+        for (std::size_t thread_index = 0; thread_index < m_workspaces.size(); ++thread_index)
+        {
+            m_workspaces[thread_index].kmeans = m_kmeans;
+        }
+    }
+    
+    
+    template<class DataType>
+    void XMeans::clustering(const std::size_t dim, const std::vector<DataType> &dataset, const std::size_t init_num_clusters, std::vector< std::vector<double> > &centroids, const std::size_t min_num)
+    {
+        // set parameter
+        m_dim = dim;
+        m_leaves.clear();
+        m_centroids.clear();
+        resetWorkspaces();
+
+        
+        // calc first k-means (クラスタ数の上限を超えない) //
+        const std::size_t num_init_clusters = (m_max_num_clusters > 0) ? std::min(init_num_clusters, m_max_num_clusters) : init_num_clusters;
+        KMeans &first_kmeans(m_workspaces[0].kmeans);
+        std::vector< std::vector<double> > child_centroids;
+        first_kmeans.setSeed(m_seed);
+        if (m_weights == NULL)
+        {
+            first_kmeans.clustering(m_dim, dataset, num_init_clusters, child_centroids, m_method);
+        }
+        else
+        {
+            first_kmeans.clustering(m_dim, dataset, *m_weights, num_init_clusters, child_centroids, m_method);
+        }
+
+
+        // クラスタごとに並べたデータIDを並べ替え配列にする //
+        const std::vector<std::size_t> &members(first_kmeans.getClusterLabels().getMembers());
+        const std::vector<std::size_t> &offsets(first_kmeans.getClusterLabels().getOffsets());
+        m_order = members;
+        std::vector<Candidate> candidates(offsets.size() - 1);
+        for (std::size_t cluster_id = 0; cluster_id < candidates.size(); ++cluster_id)
+        {
+            candidates[cluster_id].begin = offsets[cluster_id];
+            candidates[cluster_id].end = offsets[cluster_id + 1];
+            candidates[cluster_id].centroid.swap(child_centroids.at(cluster_id));
+            candidates[cluster_id].seed = scl::rng::streamSeed(m_seed, cluster_id);
+        }
+
+
+        // x-means
+        splitCandidates(dataset, candidates, min_num, 0);
+
+        
+        // copy results
+        std::vector<std::uint32_t> &labels = m_labels.resetLabels(dataset.size(), m_leaves.size());
+        m_labels.setDataIds(std::vector<std::size_t>());
+        for (std::size_t cluster_id = 0; cluster_id < m_leaves.size(); ++cluster_id)
+        {
+            for (std::size_t i = m_leaves[cluster_id].begin; i < m_leaves[cluster_id].end; ++i)
+            {
+                labels[m_order[i]] = static_cast<std::uint32_t>(cluster_id);
+            }
+            m_centroids.push_back(m_leaves[cluster_id].centroid);
+        }
+
+
+        // 確定した重心から全データで k-means //
+        if (m_is_refined && !m_centroids.empty())
+        {
+            KMeans &refine_kmeans(m_workspaces[0].kmeans);
+            refine_kmeans.setSeed(m_seed);
+            if (m_weights == NULL)
+            {
+                refine_kmeans.clustering(m_dim, dataset, m_centroids.size(), m_centroids, KMeans::MANUAL);
+            }
+            else
+            {
+                refine_kmeans.clustering(m_dim, dataset, *m_weights, m_centroids.size(), m_centroids, KMeans::MANUAL);
+            }
+            m_labels = refine_kmeans.getClusterLabels();
+        }
+
+        // 更新用の十分統計量は最初の XMeans::update で作る //
+        std::vector<ClusterStatistics>().swap(m_statistics);
+        std::vector<double>().swap(m_evaluated_weights);
+        m_num_updates = 0;
+        m_init_num_clusters = num_init_clusters;
+        
+        centroids.clear();
+        centroids.assign(m_centroids.begin(), m_centroids.end());
+        std::vector<Candidate>().swap(m_leaves);
+        std::vector<std::size_t>().swap(m_order);
+        std::vector<Workspace>().swap(m_workspaces);
+    }
+
+
+    template<class DataType>
+    void XMeans::clustering(const std::size_t dim, const std::vector<DataType> &dataset, const std::vector<double> &weights,
+                            const std::size_t init_num_clusters, std::vector< std::vector<double> > &centroids, const std::size_t min_num)
+    {
+        // size check
+        if (weights.size() != dataset.size())
+        {
+            return;
+        }
+
+        m_weights = &weights;
+        clustering(dim, dataset, init_num_clusters, centroids, min_num);
+        m_weights = NULL;
+    }
+
+
+    template<class DataType>
+    void XMeans::update(const std::size_t dim, const std::vector<DataType> &dataset, const std::size_t num_old_data, std::vector< std::vector<double> > &centroids, const std::size_t min_num)
+    {
+        // size check (前回の結果と合わなければ何もしない)
+        const std::size_t num_clusters(m_centroids.size());
+        if ( dim != m_dim || num_clusters == 0
+             || num_old_data != m_labels.getLabels().size() || !m_labels.getDataIds().empty() || dataset.size() < num_old_data )
+        {
+            return;
+        }
+
+        // clustering 後の最初の更新なら、前回のデータから各クラスタの十分統計量を作る //
+        if ( m_statistics.empty() )
+        {
+            setClusterStatistics(dataset);
+        }
+        if ( m_statistics.size() != num_clusters )
+        {
+            return;
+        }
+        if ( m_splitting_type == XMeans::BIC_ISHIOKA && static_cast<std::size_t>(m_statistics.front().scatter.rows()) != m_dim )
+        {
+            return;
+        }
+        resetWorkspaces();
+        ++m_num_updates;
+        const std::uint64_t update_seed( scl::rng::streamSeed(m_seed, m_num_updates) );
+
+        
+        // 追加データを最も近いクラスタに割り当てる //
+        const std::size_t num_data(dataset.size());
+        std::vector<std::uint32_t> labels(m_labels.getLabels());
+        labels.resize(num_data, 0);
+        #pragma omp parallel for
+        for (std::size_t data_index = num_old_data; data_index < num_data; ++data_index)
+        {
+            labels[data_index] = static_cast<std::uint32_t>(findNearestCluster(dataset[data_index]));
+        }
+
+        // 十分統計量に足す (データ順) //
+        std::vector<double> added_weights(num_clusters, 0.0);
+        Eigen::VectorXd diff(m_dim);
+        for (std::size_t data_index = num_old_data; data_index < num_data; ++data_index)
+        {
+            const std::uint32_t label(labels[data_index]);
+            const double weight = (m_weights == NULL) ? 1.0 : (*m_weights)[data_index];
+            addStatistics(dataset[data_index], weight, m_statistics[label], diff);
+            added_weights[label] += weight;
+        }
+        std::vector<bool> is_changed(num_clusters, false);
+        for (std::size_t cluster_id = 0; cluster_id < num_clusters; ++cluster_id)
+        {
+            completeScatter(m_statistics[cluster_id]);
+            m_centroids[cluster_id] = calcMean(m_statistics[cluster_id]);
+            is_changed[cluster_id] = ( added_weights[cluster_id] > 0.0
+                                       && m_statistics[cluster_id].weight - m_evaluated_weights[cluster_id] >= m_update_ratio * m_evaluated_weights[cluster_id] );
+        }
+
+
+        // 変化したクラスタは最も近いクラスタとの統合を評価する (十分統計量だけで求まる) //
+        // (XMeans::ANDERSON_DARLING では isSplitBetter が常に true なので統合しない) //
+        std::vector<std::size_t> merged_ids(num_clusters);  // 統合先のクラスタID (統合しなければ自分)
+        std::vector<bool> is_merged(num_clusters, false);   // 今回統合してできたクラスタか
+        for (std::size_t cluster_id = 0; cluster_id < num_clusters; ++cluster_id)
+        {
+            merged_ids[cluster_id] = cluster_id;
+        }
+        std::size_t num_merged_clusters(num_clusters);
+        for (std::size_t cluster_id = 0; cluster_id < num_clusters && num_merged_clusters > m_init_num_clusters; ++cluster_id)
+        {
+            if ( !is_changed[cluster_id] || merged_ids[cluster_id] != cluster_id || is_merged[cluster_id] )
+            {
+                continue;
+            }
+
+            std::size_t nearest_cluster_id(num_clusters);
+            double nearest_squared_distance( std::numeric_limits<double>::max() );
+            for (std::size_t other_id = 0; other_id < num_clusters; ++other_id)
+            {
+                if ( other_id == cluster_id || merged_ids[other_id] != other_id || is_merged[other_id] )
+                {
+                    continue;
+                }
+                const double squared_distance = ( scl::toEigenVector(m_dim, m_centroids[cluster_id]) - scl::toEigenVector(m_dim, m_centroids[other_id]) ).squaredNorm();
+                if (squared_distance < nearest_squared_distance)
+                {
+                    nearest_squared_distance = squared_distance;
+                    nearest_cluster_id = other_id;
+                }
+            }
+            if (nearest_cluster_id == num_clusters)
+            {
+                continue;
+            }
+
+            // 2つのクラスタを1つの分割とみなして、分割したほうが良ければ統合しない //
+            std::vector<ClusterStatistics> pair_statistics(1, m_statistics[cluster_id]);
+            pair_statistics.push_back(m_statistics[nearest_cluster_id]);
+            std::vector< std::vector<double> > pair_centroids(1, m_centroids[cluster_id]);
+            pair_centroids.push_back(m_centroids[nearest_cluster_id]);
+            std::vector<ClusterStatistics> merged_statistics(1, m_statistics[cluster_id]);
+            mergeStatistics(merged_statistics[0], m_statistics[nearest_cluster_id]);
+            std::vector< std::vector<double> > merged_centroids(1, calcMean(merged_statistics[0]));
+            double gain(0.0);
+            if ( isSplitBetter(merged_statistics, merged_centroids, pair_statistics, pair_centroids, gain) )
+            {
+                continue;
+            }
+            m_statistics[cluster_id] = merged_statistics[0];
+            m_centroids[cluster_id].swap(merged_centroids[0]);
+            m_evaluated_weights[cluster_id] = m_statistics[cluster_id].weight;
+            merged_ids[nearest_cluster_id] = cluster_id;
+            is_merged[cluster_id] = true;
+            --num_merged_clusters;
+        }
+
+
+        // 分割をやり直すクラスタのデータを m_order にクラスタID順に並べる //
+        std::vector<bool> is_resplit(num_clusters, false);
+        for (std::size_t cluster_id = 0; cluster_id < num_clusters; ++cluster_id)
+        {
+            is_resplit[cluster_id] = ( is_changed[cluster_id] && merged_ids[cluster_id] == cluster_id && !is_merged[cluster_id] );
+        }
+        std::vector<std::size_t> offsets(num_clusters + 1, 0);
+        for (std::size_t data_index = 0; data_index < num_data; ++data_index)
+        {
+            const std::size_t cluster_id(merged_ids[labels[data_index]]);
+            if (is_resplit[cluster_id])
+            {
+                ++offsets[cluster_id + 1];
+            }
+        }
+        for (std::size_t cluster_id = 0; cluster_id < num_clusters; ++cluster_id)
+        {
+            offsets[cluster_id + 1] += offsets[cluster_id];
+        }
+        std::vector<std::size_t> positions(offsets.begin(), offsets.end() - 1);
+        m_order.resize(offsets.back());
+        for (std::size_t data_index = 0; data_index < num_data; ++data_index)
+        {
+            const std::size_t cluster_id(merged_ids[labels[data_index]]);
+            if (is_resplit[cluster_id])
+            {
+                m_order[positions[cluster_id]++] = data_index;
+            }
+        }
+
+        std::vector<Candidate> candidates;
+        std::size_t num_fixed_clusters(0);
+        for (std::size_t cluster_id = 0; cluster_id < num_clusters; ++cluster_id)
+        {
+            if (is_resplit[cluster_id])
+            {
+                Candidate candidate;
+                candidate.begin = offsets[cluster_id];
+                candidate.end = offsets[cluster_id + 1];
+                candidate.centroid = m_centroids[cluster_id];
+                candidate.seed = scl::rng::streamSeed(update_seed, cluster_id);
+                candidates.push_back(candidate);
+            }
+            else if (merged_ids[cluster_id] == cluster_id)
+            {
+                ++num_fixed_clusters;
+            }
+        }
+
+
+        // x-means (分割をやり直すクラスタだけ)
+        m_leaves.clear();
+        splitCandidates(dataset, candidates, min_num, num_fixed_clusters);
+
+
+        // クラスタIDを振り直す (元のクラスタID順。分割したクラスタの子クラスタは続けて並べる) //
+        std::vector<ClusterStatistics> statistics;
+        std::vector<double> evaluated_weights;
+        std::vector< std::vector<double> > new_centroids;
+        std::vector<std::uint32_t> new_labels(num_data, 0);
+        std::vector<std::uint32_t> new_ids(num_clusters, 0);
+        std::size_t leaf_index(0);
+        for (std::size_t cluster_id = 0; cluster_id < num_clusters; ++cluster_id)
+        {
+            if (merged_ids[cluster_id] != cluster_id)
+            {
+                continue;
+            }
+            if ( !is_resplit[cluster_id] )
+            {
+                new_ids[cluster_id] = static_cast<std::uint32_t>(statistics.size());
+                statistics.push_back(m_statistics[cluster_id]);
+                evaluated_weights.push_back(m_evaluated_weights[cluster_id]);
+                new_centroids.push_back(m_centroids[cluster_id]);
+                continue;
+            }
+            for (; leaf_index < m_leaves.size() && m_leaves[leaf_index].end <= offsets[cluster_id + 1]; ++leaf_index)
+            {
+                const Candidate &leaf(m_leaves[leaf_index]);
+                for (std::size_t i = leaf.begin; i < leaf.end; ++i)
+                {
+                    new_labels[m_order[i]] = static_cast<std::uint32_t>(statistics.size());
+                }
+                statistics.push_back(ClusterStatistics());
+                calcStatistics(dataset, leaf.begin, leaf.end, leaf.centroid, statistics.back());
+                evaluated_weights.push_back(statistics.back().weight);
+                new_centroids.push_back(leaf.centroid);
+            }
+        }
+        for (std::size_t data_index = 0; data_index < num_data; ++data_index)
+        {
+            const std::size_t cluster_id(merged_ids[labels[data_index]]);
+            if ( !is_resplit[cluster_id] )
+            {
+                new_labels[data_index] = new_ids[cluster_id];
+            }
+        }
+
+
+        // copy results
+        m_labels.resetLabels(num_data, statistics.size()).swap(new_labels);
+        m_statistics.swap(statistics);
+        m_evaluated_weights.swap(evaluated_weights);
+        m_centroids.swap(new_centroids);
+        centroids.clear();
+        centroids.assign(m_centroids.begin(), m_centroids.end());
+        std::vector<Candidate>().swap(m_leaves);
+        std::vector<std::size_t>().swap(m_order);
+        std::vector<Workspace>().swap(m_workspaces);
+    }
+
+
+    template<class DataType>
+    void XMeans::update(const std::size_t dim, const std::vector<DataType> &dataset, const std::vector<double> &weights,
+                        const std::size_t num_old_data, std::vector< std::vector<double> > &centroids, const std::size_t min_num)
+    {
+        // size check
+        if (weights.size() != dataset.size())
+        {
+            return;
+        }
+
+        m_weights = &weights;
+        update(dim, dataset, num_old_data, centroids, min_num);
+        m_weights = NULL;
+    }
+
+
+    double XMeans::sumWeights(const std::size_t begin, const std::size_t end) const
+    {
+        if (m_weights == NULL)
+        {
+            return static_cast<double>(end - begin);
+        }
+
+        double sum(0.0);
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            sum += (*m_weights)[m_order[i]];
+        }
+        return sum;
+    }
+
+
+    bool XMeans::isTooSmall(const std::size_t begin, const std::size_t end, const std::size_t min_num) const
+    {
+        if ( m_weights != NULL && end - begin <= m_dim )
+        {
+            return true;
+        }
+        return ( sumWeights(begin, end) < static_cast<double>(min_num) );
+    }
+
+
+    void XMeans::addCluster(const Candidate &candidate)
+    {
+        #pragma omp critical(xmeans_add_cluster)
+        m_leaves.push_back(candidate);
+    }
+
+
+    template<class DataType>
+    std::size_t XMeans::partitionByLabels(Workspace &workspace, const std::vector<DataType> &dataset, const Candidate &candidate, ClusterStatistics *statistics)
+    {
+        const Eigen::VectorXd reference( scl::toEigenVector(m_dim, candidate.centroid) );
+        resetStatistics(reference, statistics[0]);
+        resetStatistics(reference, statistics[1]);
+
+        // ラベル 0 はその場で前に詰め、ラベル 1 は作業領域に退避してから後ろに戻す //
+        // (m_order の [begin, end) はこのクラスタの task だけが触る) //
+        std::vector<std::size_t> &order(m_order);
+        const std::vector<std::uint32_t> &labels(workspace.kmeans.getLabels());
+        const std::size_t begin(candidate.begin), end(candidate.end);
+        Eigen::VectorXd diff(m_dim);
+        workspace.partition_buffer.clear();
+        std::size_t mid(begin);
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            const std::size_t data_index(order[i]);
+            const std::uint32_t label(labels[i - begin]);
+            if (label == 0)
+            {
+                order[mid++] = data_index;
+            }
+            else
+            {
+                workspace.partition_buffer.push_back(data_index);
+            }
+
+            // 十分統計量 //
+            const double weight = (m_weights == NULL) ? 1.0 : (*m_weights)[data_index];
+            addStatistics(dataset[data_index], weight, statistics[label], diff);
+        }
+        std::copy(workspace.partition_buffer.begin(), workspace.partition_buffer.end(), order.begin() + mid);
+
+        completeScatter(statistics[0]);
+        completeScatter(statistics[1]);
+        return mid;
+    }
+
+
+    double XMeans::calcSquaredError(const ClusterStatistics &statistics, const std::vector<double> &centroid) const
+    {
+        // Σ w |d - e|^2 = Σ w |d|^2 - 2 e・Σ w d + W |e|^2  (e = centroid - reference) //
+        const Eigen::VectorXd offset(scl::toEigenVector(m_dim, centroid) - statistics.reference);
+        const double squared_error = statistics.squared_sum - 2.0 * offset.dot(statistics.sum) + statistics.weight * offset.squaredNorm();
+        return std::max(squared_error, 0.0);
+    }
+
+
+    Eigen::MatrixXd XMeans::calcCovariance(const ClusterStatistics &statistics) const
+    {
+        // (Σ w d d^T - (Σ w d)(Σ w d)^T / W) / (W - 1) //
+        return (statistics.scatter - statistics.sum * statistics.sum.transpose() / statistics.weight) / (statistics.weight - 1.0);
+    }
+
 
+    double XMeans::calcLogLikelihood(const ClusterStatistics &statistics, const std::vector<double> &mean) const
+    {
+        // mean まわりの散布行列 Σ w (d - e)(d - e)^T  (e = mean - reference) //
+        const Eigen::VectorXd offset(scl::toEigenVector(m_dim, mean) - statistics.reference);
+        const Eigen::MatrixXd centered_scatter = statistics.scatter
+            - offset * statistics.sum.transpose() - statistics.sum * offset.transpose()
+            + statistics.weight * offset * offset.transpose();
+        return scl::normal::calcLogLikelihood(statistics.weight, centered_scatter, calcCovariance(statistics));
+    }
 
-        /**
-         * @brief 指定したクラスタの情報取得
-         * @see KMeans::m_clusterid_to_dataids
-         */
-        const std::vector<std::size_t> & getCluster(const std::size_t cluster_id) const;
 
-        
-    private:
-        /**
-         * @brief split data (x-means main algorithm)
-         * @param[in] dataset クラスタリングする全データ
-         * @param[in] indices 分割予定のクラスタのインデックスリスト
-         * @param[in] centered 分割予定のクラスタの重心
-         * @param[in] min_num クラスタ内の最小データ数 (これ以下なら分割しない)
-         */
-        template<class DataType>
-        void recursivelySplit(const std::vector<DataType> &dataset, const std::vector<std::size_t> &indices, const std::vector<double> &centroid, const std::size_t min_num);
+    void XMeans::resetStatistics(const Eigen::VectorXd &reference, ClusterStatistics &statistics) const
+    {
+        statistics.reference = reference;
+        statistics.weight = 0.0;
+        statistics.sum.setZero(m_dim);
+        statistics.squared_sum = 0.0;
+        if (m_splitting_type == XMeans::BIC_ISHIOKA)
+        {
+            statistics.scatter.setZero(m_dim, m_dim);
+        }
+        else
+        {
+            statistics.scatter.resize(0, 0);
+        }
+    }
 
 
-        /**
-         * @brief Bayesian information criterion, BIC
-         * @details pyclustering を参考にした @n
-         * <a href="https://github.com/annoviko/pyclustering">GitHub</a>
-         * @bug たまに結果がよろしくない。
-         *      分割するときのスコアを0.95倍にすると割といい感じ。
-         */
-        template<class DataType>
-        double bayesianInformationCriterion(const std::vector<DataType> &dataset, const std::vector<std::vector<std::size_t> > &indices_list, const std::vector<std::vector<double> > &centroids);
+    template<class DataType>
+    void XMeans::addStatistics(const DataType &point, const double weight, ClusterStatistics &statistics, Eigen::VectorXd &diff) const
+    {
+        for (std::size_t j = 0; j < m_dim; ++j)
+        {
+            diff(j) = static_cast<double>(point[j]) - statistics.reference(j);
+        }
+        statistics.weight += weight;
+        statistics.sum += weight * diff;
+        statistics.squared_sum += weight * diff.squaredNorm();
+        if (statistics.scatter.size() > 0)
+        {
+            statistics.scatter.selfadjointView<Eigen::Lower>().rankUpdate(diff, weight);
+        }
+    }
 
-        
-        /**
-         * @brief Bayesian information criterion, BIC
-         * @details 論文の石岡の手法 @n
-         * <a href="https://web-salad.hateblo.jp/entry/2014/07/19/200347">参考ブログ</a> @n
-         * <a href="https://gist.github.com/yasaichi/254a060eff56a3b3b858#file-x_means-py">↑のGist</a>
-         * @bug あまり結果がよろしくない・・・移植ミス？
-         */
-        template<class DataType>
-        double bayesianInformationCriterionIshioka(const std::vector<DataType> &dataset, const std::vector<std::vector<std::size_t> > &indices_list, const std::vector<std::vector<double> > &centroids);
 
+    void XMeans::completeScatter(ClusterStatistics &statistics) const
+    {
+        if (statistics.scatter.size() > 0)
+        {
+            statistics.scatter.triangularView<Eigen::StrictlyUpper>() = statistics.scatter.transpose();
+        }
+    }
 
-        /**
-         * @brief Minimum noiseless description length
-         * @todo 実装
-         */
-        double minimumNoiselessDescriptionLength();
 
-        
-        /** @brief クラスタリングするデータの次数 */
-        std::size_t m_dim;
+    void XMeans::mergeStatistics(ClusterStatistics &statistics, const ClusterStatistics &other) const
+    {
+        // other の差 d を statistics の基準点からの差 d + s に直す (s = other.reference - statistics.reference) //
+        const Eigen::VectorXd shift(other.reference - statistics.reference);
+        if (statistics.scatter.size() > 0 && other.scatter.size() > 0)
+        {
+            statistics.scatter += other.scatter
+                + shift * other.sum.transpose() + other.sum * shift.transpose()
+                + other.weight * shift * shift.transpose();
+        }
+        statistics.squared_sum += other.squared_sum + 2.0 * shift.dot(other.sum) + other.weight * shift.squaredNorm();
+        statistics.sum += other.sum + other.weight * shift;
+        statistics.weight += other.weight;
+    }
 
 
-        /** @brief x-means で確定したクラスタ情報 */
-        std::vector< std::vector<std::size_t> > m_clusterid_to_dataids;
+    std::vector<double> XMeans::calcMean(const ClusterStatistics &statistics) const
+    {
+        Eigen::VectorXd mean(statistics.reference);
+        if (statistics.weight > 0.0)
+        {
+            mean += statistics.sum / statistics.weight;
+        }
+        return std::vector<double>(mean.data(), mean.data() + m_dim);
+    }
 
 
-        /** @brief x-means で確定したクラスタの各重心 */
-        std::vector< std::vector<double> > m_centroids;
-                
-        
-        /** @brief k-means class */
-        scl::KMeans m_kmeans;
+    template<class DataType>
+    void XMeans::calcStatistics(const std::vector<DataType> &dataset, const std::size_t begin, const std::size_t end,
+                                const std::vector<double> &reference, ClusterStatistics &statistics) const
+    {
+        resetStatistics(scl::toEigenVector(m_dim, reference), statistics);
+        Eigen::VectorXd diff(m_dim);
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            const std::size_t data_index(m_order[i]);
+            const double weight = (m_weights == NULL) ? 1.0 : (*m_weights)[data_index];
+            addStatistics(dataset[data_index], weight, statistics, diff);
+        }
+        completeScatter(statistics);
+    }
 
-        
-        /** @brief k-means method */
-        KMeans::InitMethod m_method;
 
+    template<class DataType>
+    void XMeans::setClusterStatistics(const std::vector<DataType> &dataset)
+    {
+        const std::size_t num_clusters(m_centroids.size());
+        const std::vector<std::size_t> &members(m_labels.getMembers());
+        const std::vector<std::size_t> &offsets(m_labels.getOffsets());
+        m_order = members;
+        m_statistics.assign(num_clusters, ClusterStatistics());
+        m_evaluated_weights.assign(num_clusters, 0.0);
+
+        #pragma omp parallel for schedule(dynamic)
+        for (std::size_t cluster_id = 0; cluster_id < num_clusters; ++cluster_id)
+        {
+            calcStatistics(dataset, offsets[cluster_id], offsets[cluster_id + 1], m_centroids[cluster_id], m_statistics[cluster_id]);
+            m_evaluated_weights[cluster_id] = m_statistics[cluster_id].weight;
+        }
+    }
 
-        /** @brief 分割時の評価方法 */
-        SplittingType m_splitting_type;
-        
-    };  // end of x-means class
 
+    template<class DataType>
+    std::size_t XMeans::findNearestCluster(const DataType &point) const
+    {
+        std::size_t nearest_cluster_id(0);
+        double nearest_squared_distance( std::numeric_limits<double>::max() );
+        for (std::size_t cluster_id = 0; cluster_id < m_centroids.size(); ++cluster_id)
+        {
+            const std::vector<double> &centroid(m_centroids[cluster_id]);
+            double squared_distance(0.0);
+            for (std::size_t j = 0; j < m_dim; ++j)
+            {
+                const double error = static_cast<double>(point[j]) - centroid[j];
+                squared_distance += error * error;
+            }
+            if (squared_distance < nearest_squared_distance)
+            {
+                nearest_squared_distance = squared_distance;
+                nearest_cluster_id = cluster_id;
+            }
+        }
+        return nearest_cluster_id;
+    }
 
 
+    const std::vector< std::vector<std::size_t> >& XMeans::getClusters() const
+    {
+        return m_labels.getClusters();
+    }
 
-    //------------------------------------------------------------------
-    // 実装部
-    //------------------------------------------------------------------
 
-    XMeans::XMeans()
-        : m_method(KMeans::PLUSPLUS),
-          m_splitting_type(XMeans::BIC_ORG)
+    const std::vector<std::size_t>& XMeans::getCluster(const std::size_t cluster_id) const
     {
+        return m_labels.getCluster(cluster_id);
     }
-    
-    
-    void XMeans::setParameters(const std::size_t max_iteration, const double tolerance, const std::size_t max_pp_trial, const KMeans::InitMethod method)
+
+
+    const std::vector<std::uint32_t>& XMeans::getLabels() const
     {
-        m_kmeans.setParameters(max_iteration, tolerance, max_pp_trial);
-        m_method = method;
+        return m_labels.getLabels();
     }
 
 
-    void XMeans::setSplittingType(const SplittingType splitting_type)
+    const ClusterLabels& XMeans::getClusterLabels() const
     {
-        m_splitting_type = splitting_type;
+        return m_labels;
     }
-    
-    
+
+
     template<class DataType>
-    void XMeans::clustering(const std::size_t dim, const std::vector<DataType> &dataset, const std::size_t init_num_clusters, std::vector< std::vector<double> > &centroids, const std::size_t min_num)
+    void XMeans::splitCandidates(const std::vector<DataType> &dataset, std::vector<Candidate> &candidates, const std::size_t min_num, const std::size_t num_fixed_clusters)
     {
-        // set parameter
-        m_dim = dim;
-        m_clusterid_to_dataids.clear();
-        m_centroids.clear();
-
+        // クラスタ数に上限があれば改善量の大きい分割から順に行う //
+        if (m_max_num_clusters > 0)
+        {
+            splitBestFirst(dataset, candidates, min_num, num_fixed_clusters);
+        }
+        else
+        {
+            // 分割候補がスレッド数より少ないうちは k-means の中で並列化する //
+            while ( !candidates.empty() && candidates.size() < m_workspaces.size() )
+            {
+                std::vector<Candidate> next_candidates;
+                for (std::size_t candidate_index = 0; candidate_index < candidates.size(); ++candidate_index)
+                {
+                    Candidate children[2];
+                    double gain(0.0);
+                    if ( splitCluster(m_workspaces[0], dataset, candidates[candidate_index], min_num, children, gain) )
+                    {
+                        next_candidates.push_back(children[0]);
+                        next_candidates.push_back(children[1]);
+                    }
+                    else
+                    {
+                        addCluster(candidates[candidate_index]);
+                    }
+                }
+                candidates.swap(next_candidates);
+            }
         
-        // calc first k-means
-        std::vector< std::vector<double> > child_centroids;
-        m_kmeans.clustering(m_dim, dataset, init_num_clusters, child_centroids, m_method);
-   
         
-        // x-means
-        const std::vector< std::vector<std::size_t> > clusters(m_kmeans.getClusters());
-        for (std::size_t cluster_id = 0; cluster_id < clusters.size(); ++cluster_id)
-        {
-            recursivelySplit(dataset, clusters.at(cluster_id), child_centroids.at(cluster_id), min_num);
+            // x-means (分割候補ごとに task にする) //
+            #pragma omp parallel
+            {
+                #pragma omp single
+                {
+                    for (std::size_t candidate_index = 0; candidate_index < candidates.size(); ++candidate_index)
+                    {
+                        #pragma omp task firstprivate(candidate_index)
+                        recursivelySplit(dataset, candidates[candidate_index], min_num);
+                    }
+                }
+            }
         }
 
-        
-        // copy results
-        centroids.clear();
-        centroids.assign(m_centroids.begin(), m_centroids.end());
+
+        // 直列に再帰したときの順 (m_order での位置の順) に並べる //
+        std::sort(m_leaves.begin(), m_leaves.end(), [](const Candidate &a, const Candidate &b)
+        {
+            if (a.begin != b.begin) { return a.begin < b.begin; }
+            if (a.end != b.end) { return a.end < b.end; }
+            return a.seed < b.seed;
+        });
     }
 
 
-    const std::vector< std::vector<std::size_t> >& XMeans::getClusters() const
+    template<class DataType>
+    void XMeans::recursivelySplit(const std::vector<DataType> &dataset, const Candidate &candidate, const std::size_t min_num)
     {
-        return m_clusterid_to_dataids;
+        Candidate children[2];
+        double gain(0.0);
+        if ( !splitCluster(m_workspaces[scl::parallel::threadNum()], dataset, candidate, min_num, children, gain) )
+        {
+            addCluster(candidate);
+            return;
+        }
+
+        // 小さいクラスタは task にせずこのスレッドで続ける //
+        // (dataset は参照なので shared にしないと task ごとにコピーされる) //
+        const std::size_t min_task_size(1024);
+        for (std::size_t split_id = 0; split_id < 2; ++split_id)
+        {
+            Candidate child(children[split_id]);
+            if (child.end - child.begin >= min_task_size)
+            {
+                #pragma omp task firstprivate(child) shared(dataset)
+                recursivelySplit(dataset, child, min_num);
+            }
+            else
+            {
+                recursivelySplit(dataset, child, min_num);
+            }
+        }
     }
 
 
-    const std::vector<std::size_t>& XMeans::getCluster(const std::size_t cluster_id) const
+    template<class DataType>
+    void XMeans::splitBestFirst(const std::vector<DataType> &dataset, const std::vector<Candidate> &candidates, const std::size_t min_num, const std::size_t num_fixed_clusters)
     {
-        return m_clusterid_to_dataids.at(cluster_id);
+        // 改善量の大きい順 (同じなら m_order での位置の順) //
+        const auto is_worse_split = [](const Split &a, const Split &b)
+        {
+            if (a.gain != b.gain) { return a.gain < b.gain; }
+            return a.parent.begin > b.parent.begin;
+        };
+
+        // 評価済みの分割の heap //
+        std::vector<Split> splits;
+        const auto evaluate = [&](const Candidate &candidate)
+        {
+            Split split;
+            if ( splitCluster(m_workspaces[0], dataset, candidate, min_num, split.children, split.gain) )
+            {
+                split.parent = candidate;
+                splits.push_back(split);
+                std::push_heap(splits.begin(), splits.end(), is_worse_split);
+            }
+            else
+            {
+                addCluster(candidate);
+            }
+        };
+
+        for (std::size_t candidate_index = 0; candidate_index < candidates.size(); ++candidate_index)
+        {
+            evaluate(candidates[candidate_index]);
+        }
+
+        // 上限までは改善量の大きい分割を採用し、子クラスタを評価する //
+        std::size_t num_clusters(num_fixed_clusters + candidates.size());
+        while ( !splits.empty() )
+        {
+            std::pop_heap(splits.begin(), splits.end(), is_worse_split);
+            const Split split(splits.back());
+            splits.pop_back();
+
+            if (num_clusters < m_max_num_clusters)
+            {
+                ++num_clusters;
+                evaluate(split.children[0]);
+                evaluate(split.children[1]);
+            }
+            else
+            {
+                addCluster(split.parent);
+            }
+        }
     }
 
 
     template<class DataType>
-    void XMeans::recursivelySplit(const std::vector<DataType> &dataset, const std::vector<std::size_t> &indices, const std::vector<double> &centroid, const std::size_t min_num)
+    bool XMeans::splitCluster(Workspace &workspace, const std::vector<DataType> &dataset, const Candidate &candidate, const std::size_t min_num, Candidate *children, double &gain)
     {
-        if ( indices.size() < min_num )
+        const std::size_t begin(candidate.begin), end(candidate.end);
+        if ( isTooSmall(begin, end, min_num) )
         {
-            m_clusterid_to_dataids.push_back(indices);
-            m_centroids.push_back(centroid);
-            return;
+            return false;
         }
 
         
-        // current data set
-        std::vector<DataType> current_dataset;
-        for (std::size_t i = 0; i < indices.size(); ++i)
+        // split (m_order の範囲をそのまま k-means に渡す)
+        KMeans &kmeans(workspace.kmeans);
+        std::vector< std::vector<double> > current_centroids;
+        bool is_converged(false);
+        kmeans.setSeed(candidate.seed);
+        if (m_weights == NULL)
         {
-            current_dataset.push_back( dataset[ indices[i] ] );
+            is_converged = kmeans.clustering(m_dim, dataset, m_order, begin, end, 2, current_centroids, m_method);
         }
-        
-        
-        // split
-        std::vector< std::vector<double> > current_centroids;
-        if ( !m_kmeans.clustering(m_dim, current_dataset, 2, current_centroids, m_method) )
+        else
         {
-            m_clusterid_to_dataids.push_back(indices);
-            m_centroids.push_back(centroid);
-            return;
+            workspace.range_weights.resize(end - begin);
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                workspace.range_weights[i - begin] = (*m_weights)[m_order[i]];
+            }
+            is_converged = kmeans.clustering(m_dim, dataset, m_order, begin, end, workspace.range_weights, 2, current_centroids, m_method);
+        }
+        if ( !is_converged )
+        {
+            return false;
         }
-        const std::vector< std::vector<std::size_t> > current_clusters(m_kmeans.getClusters());
+        std::vector<ClusterStatistics> split_statistics(2);
+        std::size_t split_offsets[3] = { begin, 0, end };
+        split_offsets[1] = partitionByLabels(workspace, dataset, candidate, &split_statistics[0]);
+
+        // 分割前のクラスタの統計量は子クラスタの和 //
+        std::vector<ClusterStatistics> current_statistics(1, split_statistics[0]);
+        mergeStatistics(current_statistics[0], split_statistics[1]);
         
         
         // size check
-        for (std::size_t current_cluster_id = 0; current_cluster_id < current_clusters.size(); ++current_cluster_id)
+        for (std::size_t split_id = 0; split_id < 2; ++split_id)
+        {
+            if ( isTooSmall(split_offsets[split_id], split_offsets[split_id + 1], min_num) )
+            {
+                return false;
+            }
+        }
+
+
+        // compare scores
+        if (m_splitting_type == XMeans::ANDERSON_DARLING)
         {
-            if ( current_clusters.at(current_cluster_id).size() < min_num )
+            // 分割軸への射影が正規分布らしくなければ分割する //
+            const double statistic = calcAndersonDarling(workspace, dataset, candidate, current_centroids);
+            if ( statistic <= m_critical_value )
             {
-                m_clusterid_to_dataids.push_back(indices);
-                m_centroids.push_back(centroid);
-                return;
+                return false;
             }
+            gain = statistic - m_critical_value;
         }
+        else if ( !isSplitBetter(current_statistics, std::vector<std::vector<double> >(1, candidate.centroid), split_statistics, current_centroids, gain) )
+        {
+            return false;
+        }
+        for (std::size_t split_id = 0; split_id < 2; ++split_id)
+        {
+            children[split_id].begin = split_offsets[split_id];
+            children[split_id].end = split_offsets[split_id + 1];
+            children[split_id].centroid.swap(current_centroids[split_id]);
+            children[split_id].seed = scl::rng::streamSeed(candidate.seed, split_id);
+        }
+        return true;
+    }
 
 
+    bool XMeans::isSplitBetter(const std::vector<ClusterStatistics> &current_statistics, const std::vector<std::vector<double> > &current_centroids,
+                               const std::vector<ClusterStatistics> &split_statistics, const std::vector<std::vector<double> > &split_centroids, double &gain) const
+    {
         // calc score
         double current_score(0.0), split_score(0.0);
         switch (m_splitting_type)
         {
         case XMeans::BIC_ISHIOKA:
         {
-            current_score = bayesianInformationCriterionIshioka(dataset, std::vector<std::vector<std::size_t> >(1, indices), std::vector<std::vector<double> >(1, centroid));
-            split_score = bayesianInformationCriterionIshioka(current_dataset, current_clusters, current_centroids);
+            current_score = bayesianInformationCriterionIshioka(current_statistics, current_centroids);
+            split_score = bayesianInformationCriterionIshioka(split_statistics, split_centroids);
             break;
         }
         case XMeans::MNDL:
+        {
+            const double squared_sigma = estimateNoiseVariance(split_statistics, split_centroids);
+            current_score = minimumNoiselessDescriptionLength(current_statistics, current_centroids, squared_sigma);
+            split_score = minimumNoiselessDescriptionLength(split_statistics, split_centroids, squared_sigma);
+            break;
+        }
         case XMeans::BIC_ORG:
         {
-            current_score = bayesianInformationCriterion(dataset, std::vector<std::vector<std::size_t> >(1, indices), std::vector<std::vector<double> >(1, centroid));
-            split_score = bayesianInformationCriterion(current_dataset, current_clusters, current_centroids);
+            current_score = bayesianInformationCriterion(current_statistics, current_centroids);
+            split_score = bayesianInformationCriterion(split_statistics, split_centroids);
             split_score *= 0.95;  // todo check
+            break;
+        }
+        case XMeans::ANDERSON_DARLING:
+        {
+            // データがないと判定できないので分割したままにする //
+            gain = 0.0;
+            return true;
         }
         }
 
         
         // compare BIC
-        if ( split_score < current_score )
+        if ( split_score >= current_score )
+        {
+            return false;
+        }
+        gain = current_score - split_score;
+        return true;
+    }
+
+
+    template<class DataType>
+    double XMeans::calcAndersonDarling(Workspace &workspace, const std::vector<DataType> &dataset, const Candidate &candidate, const std::vector<std::vector<double> > &split_centroids) const
+    {
+        // 分割軸 v = c0 - c1 に射影 //
+        const Eigen::VectorXd axis( scl::toEigenVector(m_dim, split_centroids.at(0)) - scl::toEigenVector(m_dim, split_centroids.at(1)) );
+        std::vector< std::pair<double, double> > &projections(workspace.projections);
+        projections.resize(candidate.end - candidate.begin);
+        double total_weight(0.0), mean(0.0);
+        for (std::size_t i = candidate.begin; i < candidate.end; ++i)
         {
-            for (std::size_t split_id = 0; split_id < 2; ++split_id)
+            const std::size_t data_index(m_order[i]);
+            double projection(0.0);
+            for (std::size_t j = 0; j < m_dim; ++j)
             {
-                std::vector<std::size_t> split_indices(current_clusters[split_id].size());
-                for (std::size_t i = 0; i < current_clusters[split_id].size(); ++i)
-                {
-                    std::size_t original_dataset_index = indices.at( current_clusters[split_id][i] );
-                    split_indices[i] = original_dataset_index;
-                }
-                recursivelySplit(dataset, split_indices, current_centroids[split_id], min_num);
+                projection += static_cast<double>(dataset[data_index][j]) * axis(j);
             }
+            const double weight = (m_weights == NULL) ? 1.0 : (*m_weights)[data_index];
+            projections[i - candidate.begin] = std::make_pair(projection, weight);
+            total_weight += weight;
+            mean += weight * projection;
+        }
+        mean /= total_weight;
+
+        // 標準化 (分散は不偏推定量) //
+        double variance(0.0);
+        for (std::size_t i = 0; i < projections.size(); ++i)
+        {
+            const double error(projections[i].first - mean);
+            variance += projections[i].second * error * error;
+        }
+        variance /= (total_weight - 1.0);
+        if ( !(variance > 0.0) )
+        {
+            return 0.0;
+        }
+        const double inverse_deviation = 1.0 / std::sqrt(variance);
+        for (std::size_t i = 0; i < projections.size(); ++i)
+        {
+            projections[i].first = (projections[i].first - mean) * inverse_deviation;
+        }
+
+        // 大きいクラスタはソートせずに近似する //
+        double statistic(0.0);
+        if (projections.size() <= m_max_sort_size)
+        {
+            statistic = scl::normal::calcAndersonDarling(projections);
         }
         else
         {
-            m_clusterid_to_dataids.push_back(indices);
-            m_centroids.push_back(centroid);
+            statistic = scl::normal::approximateAndersonDarling(projections, projections.size() / 16, workspace.histogram);
         }
+        return statistic * (1.0 + 4.0 / total_weight - 25.0 / (total_weight * total_weight));
     }
 
 
-    template<class DataType>
-    double XMeans::bayesianInformationCriterion(const std::vector<DataType> &dataset, const std::vector<std::vector<std::size_t> > &indices_list, const std::vector<std::vector<double> > &centroids)
+    double XMeans::bayesianInformationCriterion(const std::vector<ClusterStatistics> &statistics, const std::vector<std::vector<double> > &centroids) const
     {
         double bic( std::numeric_limits<double>::max() );
         
         /* 計算に使うので先にdoubleにキャストしておく */
+        const std::size_t num_clusters(statistics.size());
         double dim(m_dim);
-        double K(indices_list.size());
+        double K(num_clusters);
         double N(0);
         double squared_sigma(0.0);
 
         // calc variance
-        for (std::size_t cluster_id = 0; cluster_id < indices_list.size(); ++cluster_id)
+        for (std::size_t cluster_id = 0; cluster_id < num_clusters; ++cluster_id)
         {
-            const std::vector<double> centroid(centroids.at(cluster_id));
-            for (std::size_t data_index = 0; data_index < indices_list.at(cluster_id).size(); ++data_index)
-            {
-                DataType data = dataset.at(indices_list.at(cluster_id).at(data_index));
-                squared_sigma += m_kmeans.calcSquaredDistance(data, centroid);
-            }
-
-            N += static_cast<double>(indices_list.at(cluster_id).size());
+            squared_sigma += calcSquaredError(statistics[cluster_id], centroids.at(cluster_id));
+            N += statistics[cluster_id].weight;
         }
 
         if ( N - K > 0 )
@@ -342,9 +1587,9 @@ namespace scl
 
             // splitting criterion
             bic = 0.0;
-            for (std::size_t cluster_id = 0; cluster_id < indices_list.size(); ++cluster_id)
+            for (std::size_t cluster_id = 0; cluster_id < num_clusters; ++cluster_id)
             {
-                double n = static_cast<double>(indices_list.at(cluster_id).size());
+                double n = statistics[cluster_id].weight;
                 double L = n * std::log(n) - n * std::log(N) - n * 0.5 * std::log(2.0 * M_PI) - n * sigma_multiplier - (n - K) * 0.5;
                 bic += p * 0.5 * std::log(N) - L;
             }
@@ -354,37 +1599,36 @@ namespace scl
     }
 
     
-    template<class DataType>
-    double XMeans::bayesianInformationCriterionIshioka(const std::vector<DataType> &dataset, const std::vector<std::vector<std::size_t> > &indices_list, const std::vector<std::vector<double> > &centroids)
+    double XMeans::bayesianInformationCriterionIshioka(const std::vector<ClusterStatistics> &statistics, const std::vector<std::vector<double> > &centroids) const
     {
         double bic(0.0);
         
         /* 計算に使うので先にdoubleにキャストしておく */
+        const std::size_t num_clusters(statistics.size());
         double p(m_dim);
         double q = p * (p + 3) * 0.5;
-        double K(indices_list.size());
         double N(0);
 
         // calc data size
-        for (std::size_t cluster_id = 0; cluster_id < indices_list.size(); ++cluster_id)
+        for (std::size_t cluster_id = 0; cluster_id < num_clusters; ++cluster_id)
         {
-            N += static_cast<double>(indices_list.at(cluster_id).size());
+            N += statistics[cluster_id].weight;
         }
 
         // calc BIC
-        for (std::size_t cluster_id = 0; cluster_id < indices_list.size(); ++cluster_id)
+        for (std::size_t cluster_id = 0; cluster_id < num_clusters; ++cluster_id)
         {
-            double log_likelihood = scl::normal::calcLogLikelihood( scl::toEigenMatrix(m_dim, dataset, indices_list.at(cluster_id)), scl::toEigenVector(m_dim, centroids.at(cluster_id)) );
+            double log_likelihood = calcLogLikelihood(statistics[cluster_id], centroids.at(cluster_id));
             bic += -2.0 * log_likelihood + q * std::log(N);
         }
 
         // split
-        if (K == 2)
+        if (num_clusters == 2)
         {
-            double squared_distance = m_kmeans.calcSquaredDistance(centroids[0], centroids[1]);
-            Eigen::MatrixXd cov0, cov1;
-            scl::calcCovariance( scl::toEigenMatrix(m_dim, dataset, indices_list[0]), cov0);
-            scl::calcCovariance( scl::toEigenMatrix(m_dim, dataset, indices_list[1]), cov1);
+            const Eigen::VectorXd centroid_diff( scl::toEigenVector(m_dim, centroids[0]) - scl::toEigenVector(m_dim, centroids[1]) );
+            double squared_distance = centroid_diff.squaredNorm();
+            const Eigen::MatrixXd cov0( calcCovariance(statistics[0]) );
+            const Eigen::MatrixXd cov1( calcCovariance(statistics[1]) );
 
             double beta = std::sqrt( squared_distance / (cov0.determinant() + cov1.determinant()) );
             double alpha = 0.5 / scl::normal::cumulativeDensityFunction(beta);
@@ -396,9 +1640,58 @@ namespace scl
     }
 
 
-    double XMeans::minimumNoiselessDescriptionLength()
+    double XMeans::minimumNoiselessDescriptionLength(const std::vector<ClusterStatistics> &statistics, const std::vector<std::vector<double> > &centroids,
+                                                     const double squared_sigma) const
+    {
+        double score( std::numeric_limits<double>::max() );
+        if (squared_sigma < 0.0)
+        {
+            return score;
+        }
+
+        /* 計算に使うので先にdoubleにキャストしておく */
+        const double alpha(0.9), beta(0.9);
+        const std::size_t num_clusters(statistics.size());
+        double K(num_clusters);
+        double N(0);
+        double W(0.0);
+
+        // 各クラスタの平均二乗誤差の和 //
+        for (std::size_t cluster_id = 0; cluster_id < num_clusters; ++cluster_id)
+        {
+            const double n(statistics[cluster_id].weight);
+            if (n <= 0.0)
+            {
+                return score;
+            }
+            W += calcSquaredError(statistics[cluster_id], centroids.at(cluster_id)) / n;
+            N += n;
+        }
+
+        double sigma = std::sqrt(squared_sigma);
+        double Kw = (1.0 - K / N) * squared_sigma;
+        double Ksa = (2.0 * alpha * sigma / std::sqrt(N)) * std::sqrt( std::max(alpha * alpha * squared_sigma / N + W - Kw * 0.5, 0.0) );
+        double UQa = W - Kw + 2.0 * alpha * alpha * squared_sigma / N + Ksa;
+        score = squared_sigma * K / N + UQa + squared_sigma * beta * std::sqrt(2.0 * K) / N;
+
+        return score;
+    }
+
+
+    double XMeans::estimateNoiseVariance(const std::vector<ClusterStatistics> &statistics, const std::vector<std::vector<double> > &centroids) const
     {
-        return 0;
+        const double K(statistics.size());
+        double N(0.0), squared_error(0.0);
+        for (std::size_t cluster_id = 0; cluster_id < statistics.size(); ++cluster_id)
+        {
+            if (statistics[cluster_id].weight <= 0.0)
+            {
+                return -1.0;
+            }
+            squared_error += calcSquaredError(statistics[cluster_id], centroids.at(cluster_id));
+            N += statistics[cluster_id].weight;
+        }
+        return (N - K > 0.0) ? squared_error / (N - K) : -1.0;
     }
 
     
@@ -13,6 +13,7 @@
 #include <algorithm> // nth_element
 #include <numeric>   // iota
 #include <limits>    // limit
+#include <cmath>     // sqrt, fabs
 //#include <queue>     // priority_queue
 
 #include <iostream>  // debug
@@ -60,10 +61,10 @@ namespace scl
              * @brief ノードのインデックス
              * @details 元データのインデックスと対応
              */
-            const std::size_t index() const { return m_index; }
+            std::size_t index() const { return m_index; }
 
             /** @brief 分割した軸 */
-            const std::size_t axis() const { return m_axis; }
+            std::size_t axis() const { return m_axis; }
 
             /**
              * @brief 子ノード
@@ -159,7 +160,7 @@ namespace scl
 
 
         /** @brief データの次数 */
-        const std::size_t dim() const { return m_dim; }
+        std::size_t dim() const { return m_dim; }
 
         
         /** @brief ツリーの根 */
@@ -192,10 +193,10 @@ namespace scl
          * @param[out] dist 最近傍点までの距離
          * @return 最近傍点のインデックス
          */
-        std::size_t nnSearch(const PointType& query, double& dist);
+        std::size_t nnSearch(const PointType& query, double& dist) const;
 
         /** @see nnSearch */
-        std::size_t nnSearch(const PointType& query);
+        std::size_t nnSearch(const PointType& query) const;
 
 
         /**
@@ -248,7 +249,7 @@ namespace scl
 
     private:
         /** @brief 2点間の距離を計算 */
-        double distance(const PointType& l, const PointType& r);
+        double distance(const PointType& l, const PointType& r) const;
 
         
         /** @brief kd-tree構築用 */
@@ -256,7 +257,7 @@ namespace scl
 
 
         /** @brief 最近傍探索用 (nearest neighbor search) */
-        void nnSearchRecursive(const NodePtr node, const PointType& query, std::size_t& guess, double& dist);
+        void nnSearchRecursive(const NodePtr node, const PointType& query, std::size_t& guess, double& dist) const;
 
 
         /** @brief k近傍探索用 (k-nearest neighbor search) */
@@ -305,7 +306,7 @@ namespace scl
     //----------------------------------------------------------------------------------------
 
     template<class PointType>
-    double KdTree<PointType>::distance(const PointType& l, const PointType& r)
+    double KdTree<PointType>::distance(const PointType& l, const PointType& r) const
     {
         double square_sum(0.0);
         for (std::size_t i = 0; i < l.size(); i++) {
@@ -380,7 +381,7 @@ namespace scl
     // 最近傍探索 (nearest neighbor search)
     //
     template<class PointType>
-    std::size_t KdTree<PointType>::nnSearch(const PointType& query)
+    std::size_t KdTree<PointType>::nnSearch(const PointType& query) const
     {
         double dist;
         return nnSearch(query, dist);
@@ -388,7 +389,7 @@ namespace scl
 
 
     template<class PointType>
-    std::size_t KdTree<PointType>::nnSearch(const PointType& query, double& dist)
+    std::size_t KdTree<PointType>::nnSearch(const PointType& query, double& dist) const
     {
         std::size_t guess(0);
 
@@ -400,7 +401,7 @@ namespace scl
 
 
     template<class PointType>
-    void KdTree<PointType>::nnSearchRecursive(const NodePtr node, const PointType& query, std::size_t& guess, double& dist)
+    void KdTree<PointType>::nnSearchRecursive(const NodePtr node, const PointType& query, std::size_t& guess, double& dist) const
     {
         if (!node) {
             return;
@@ -115,6 +115,28 @@ namespace scl
     }
 
 
+    /**
+     * @brief convert matrix data : STL -> Eigen
+     * @details indices[begin] ... indices[end-1] の行だけ
+     */
+    template<class DataType>
+    Eigen::MatrixXd toEigenMatrix(const std::size_t dim, const std::vector<DataType> & stl_mat, const std::vector<std::size_t> &indices, const std::size_t begin, const std::size_t end)
+    {
+        // copy
+        const std::size_t num( end - begin );
+        Eigen::MatrixXd eigen_mat(num, dim);
+        for (std::size_t i = 0; i < num; ++i)
+        {
+            std::size_t index(indices[begin + i]);
+            for (std::size_t j = 0; j < dim; ++j)
+            {
+                eigen_mat(i,j) = static_cast<double>(stl_mat[index][j]);
+            }
+        }
+        return eigen_mat;
+    }
+
+
     /** 
      * @brief convert vector data : DataType -> Eigen
      */
@@ -0,0 +1,90 @@
+/**
+ * @file Parallel.hpp
+ * @brief OpenMP で並列化するときの補助関数
+ * @details -fopenmp なしでコンパイルした場合は直列に実行される
+ */
+
+#ifndef SCL_PARALLEL_HPP
+#define SCL_PARALLEL_HPP
+
+#include <vector>
+#include <cstddef>
+#include <algorithm>  // min
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace scl
+{
+    /** @brief 並列計算 */
+    namespace parallel
+    {
+        /**
+         * @brief 並列領域で使われる最大スレッド数
+         * @return -fopenmp なしなら 1
+         */
+        inline std::size_t maxThreads()
+        {
+#ifdef _OPENMP
+            return static_cast<std::size_t>(omp_get_max_threads());
+#else
+            return 1;
+#endif
+        }
+
+
+        /**
+         * @brief 実行中のスレッド番号 (スレッドごとの作業領域を選ぶときに使う)
+         * @return 並列領域の外や -fopenmp なしなら 0
+         */
+        inline std::size_t threadNum()
+        {
+#ifdef _OPENMP
+            return static_cast<std::size_t>(omp_get_thread_num());
+#else
+            return 0;
+#endif
+        }
+
+
+        /**
+         * @brief 和の並列計算
+         * @details 固定長のブロックごとに部分和を求めてブロック順に足し合わせる。
+         * reduction(+) と違って加算順序がスレッド数に依存しないので、結果がビット単位で一致する
+         * @param[in] num 要素数
+         * @param[in] function i 番目の値を返す関数 double(std::size_t) (並列に呼ばれる)
+         * @return function(0) + ... + function(num-1)
+         */
+        template<class Function>
+        double sum(const std::size_t num, const Function &function)
+        {
+            const std::size_t block_size(4096);
+            const std::size_t num_blocks((num + block_size - 1) / block_size);
+            std::vector<double> partial_sums(num_blocks, 0.0);
+
+            #pragma omp parallel for schedule(static)
+            for (std::size_t block = 0; block < num_blocks; ++block)
+            {
+                const std::size_t end(std::min(num, (block + 1) * block_size));
+                double partial_sum(0.0);
+                for (std::size_t i = block * block_size; i < end; ++i)
+                {
+                    partial_sum += function(i);
+                }
+                partial_sums[block] = partial_sum;
+            }
+
+            double total(0.0);
+            for (std::size_t block = 0; block < num_blocks; ++block)
+            {
+                total += partial_sums[block];
+            }
+            return total;
+        }
+        
+    } // end namespace parallel
+
+} // end namespace scl
+
+#endif
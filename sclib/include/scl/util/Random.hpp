@@ -0,0 +1,70 @@
+/**
+ * @file Random.hpp
+ * @brief 再現性のある乱数 (シード指定・並列用の乱数列)
+ */
+
+#ifndef SCL_RANDOM_HPP
+#define SCL_RANDOM_HPP
+
+#include <random>
+#include <cstdint>
+
+namespace scl
+{
+    /** @brief 乱数 */
+    namespace rng
+    {
+        /**
+         * @brief splitmix64 (64bit のハッシュ)
+         * <a href="http://xoshiro.di.unimi.it/splitmix64.c">splitmix64.c</a>
+         */
+        inline std::uint64_t splitmix64(std::uint64_t x)
+        {
+            x += 0x9E3779B97F4A7C15ULL;
+            x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+            return x ^ (x >> 31);
+        }
+
+
+        /**
+         * @brief シードとインデックスから [0, 1) の一様乱数を計算
+         * @details 乱数器の状態を持たないので、並列ループ内でもスレッド数によらず同じ値になる
+         */
+        inline double hashedUniform(const std::uint64_t seed, const std::uint64_t index)
+        {
+            std::uint64_t z = splitmix64(seed + index * 0x9E3779B97F4A7C15ULL);
+            return static_cast<double>(z >> 11) * (1.0 / 9007199254740992.0);  // 53bit / 2^53
+        }
+
+
+        /**
+         * @brief 元のシードから stream 番号ごとに独立したシードを作る
+         * @details 並列タスクやスレッドごとに乱数器を持たせるときに使う
+         */
+        inline std::uint64_t streamSeed(const std::uint64_t seed, const std::uint64_t stream)
+        {
+            return splitmix64(seed ^ splitmix64(stream));
+        }
+
+
+        /** @brief std::random_device による非決定的なシード */
+        inline std::uint64_t randomSeed()
+        {
+            std::random_device seed_gen;
+            return (static_cast<std::uint64_t>(seed_gen()) << 32) | seed_gen();
+        }
+
+
+        /** @brief 64bit のシードから std::mt19937 を作成 */
+        inline std::mt19937 makeEngine(const std::uint64_t seed)
+        {
+            std::seed_seq seq{ static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32) };
+            return std::mt19937(seq);
+        }
+        
+    } // end namespace rng
+
+} // end namespace scl
+
+#endif
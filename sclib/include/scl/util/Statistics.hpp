@@ -9,9 +9,13 @@
 
 #include <vector>
 #include <cmath>
+#include <limits>
+#include <utility>    // pair
+#include <algorithm>  // sort, min, max
 
 #include <Eigen/Core>
 #include <Eigen/LU>
+#include <Eigen/Cholesky>
 
 namespace scl
 {
@@ -36,6 +40,30 @@ namespace scl
     }
 
 
+    /**
+     * @brief calc weighted covariance-matrix
+     * @param[in] dataset dataset (num data x dim)
+     * @param[in] weights 各データの重み (重み w のデータは w 個の同じデータとして扱う)
+     * @param[out] covariance covariance-matrix
+     * @return size check
+     * @details 不偏推定量 (重みの和 - 1 で割る)
+     */
+    bool calcCovariance(const Eigen::MatrixXd &dataset, const Eigen::VectorXd &weights, Eigen::MatrixXd &covariance)
+    {
+        const double total_weight(weights.sum());
+        if ( dataset.rows() < 2 || total_weight <= 1.0 )
+        {
+            return false;
+        }
+
+        Eigen::RowVectorXd mean = (weights.transpose() * dataset) / total_weight;
+        Eigen::MatrixXd centered = dataset.rowwise() - mean;
+        covariance = (centered.adjoint() * weights.asDiagonal() * centered) / (total_weight - 1.0);
+
+        return true;
+    }
+
+
     /** @brief 正規分布モデル */
     namespace normal
     {
@@ -65,6 +93,110 @@ namespace scl
         }
         
         
+        /**
+         * @brief Anderson-Darling 統計量の1区間分 \f$ \int_a^b \frac{(F - u)^2}{u(1-u)} du \f$ (F は区間内で一定)
+         * @details \f$ \frac{(F - u)^2}{u(1-u)} = \frac{F^2}{u} + \frac{(1-F)^2}{1-u} - 1 \f$ なので閉じた式で求まる
+         */
+        double integrateAndersonDarling(const double F, const double a, const double b)
+        {
+            double integral = -(b - a);
+            if (F > 0.0)
+            {
+                integral += F * F * std::log(b / a);
+            }
+            if (F < 1.0)
+            {
+                integral += (1.0 - F) * (1.0 - F) * std::log((1.0 - a) / (1.0 - b));
+            }
+            return integral;
+        }
+
+
+        /**
+         * @brief 標準正規分布との Anderson-Darling 統計量 (重み付き)
+         * \f{eqnarray*}{ A^2 = W \int_0^1 \frac{(F_W(u) - u)^2}{u(1-u)} du, \quad u = \Phi(z) \f}
+         * @details 経験分布 \f$ F_W \f$ は階段関数なので、区間ごとの積分を閉じた式で足し合わせる
+         * (重みが全て1なら通常の式と同じ値になる)。ソートするので O(n log n)
+         * @param[in,out] samples (標準化した値 z, 重み w) の配列 (z の順に並べ替える)
+         * @return 補正前の統計量 \f$ A^2 \f$ (データがなければ 0)
+         */
+        double calcAndersonDarling(std::vector< std::pair<double, double> > &samples)
+        {
+            std::sort(samples.begin(), samples.end());
+
+            // 累積分布関数の値が 0, 1 にならないようにする //
+            const double epsilon(1.0e-15);
+            double total_weight(0.0);
+            for (std::size_t i = 0; i < samples.size(); ++i)
+            {
+                total_weight += samples[i].second;
+            }
+            if (total_weight <= 0.0)
+            {
+                return 0.0;
+            }
+
+            double integral(0.0), cumulative_weight(0.0), u_prev(0.0);
+            for (std::size_t i = 0; i < samples.size(); ++i)
+            {
+                const double u = std::min(std::max(cumulativeDensityFunction(samples[i].first), epsilon), 1.0 - epsilon);
+                integral += integrateAndersonDarling(cumulative_weight / total_weight, u_prev, u);
+                cumulative_weight += samples[i].second;
+                u_prev = u;
+            }
+            integral += integrateAndersonDarling(1.0, u_prev, 1.0);
+            return total_weight * integral;
+        }
+
+
+        /**
+         * @brief 標準正規分布との Anderson-Darling 統計量のソートしない近似
+         * @details \f$ u = \Phi(z) \f$ を num_bins 個の等幅のビンに集計し、各ビンのデータはビンの中央にあるとみなす。
+         * O(n + num_bins)。ビンあたりのデータ数が少ないほど正確になる
+         * @param[in] samples (標準化した値 z, 重み w) の配列
+         * @param[in] num_bins ビンの数
+         * @param[in,out] histogram 作業領域
+         * @see calcAndersonDarling
+         */
+        double approximateAndersonDarling(const std::vector< std::pair<double, double> > &samples, const std::size_t num_bins, std::vector<double> &histogram)
+        {
+            if (num_bins == 0)
+            {
+                return 0.0;
+            }
+
+            // histogram
+            histogram.assign(num_bins, 0.0);
+            double total_weight(0.0);
+            for (std::size_t i = 0; i < samples.size(); ++i)
+            {
+                const double u = cumulativeDensityFunction(samples[i].first);
+                const std::size_t bin = std::min(static_cast<std::size_t>(u * num_bins), num_bins - 1);
+                histogram[bin] += samples[i].second;
+                total_weight += samples[i].second;
+            }
+            if (total_weight <= 0.0)
+            {
+                return 0.0;
+            }
+
+            double integral(0.0), cumulative_weight(0.0), u_prev(0.0);
+            for (std::size_t bin = 0; bin < num_bins; ++bin)
+            {
+                if (histogram[bin] <= 0.0)
+                {
+                    continue;
+                }
+                const double u = (bin + 0.5) / num_bins;
+                integral += integrateAndersonDarling(cumulative_weight / total_weight, u_prev, u);
+                cumulative_weight += histogram[bin];
+                u_prev = u;
+            }
+            integral += integrateAndersonDarling(1.0, u_prev, 1.0);
+            return total_weight * integral;
+        }
+        
+        
         /**
          * @brief multivariate probability density function
          */
@@ -85,30 +217,68 @@ namespace scl
         }
         
         
+        /**
+         * @brief 散布行列からの対数尤度 \f$ \Sigma w log(pdf) \f$
+         * \f{eqnarray*}{ \Sigma w log(pdf) = -\frac{1}{2} \left( W (p log(2\pi) + log|\Sigma|) + tr(\Sigma^{-1} S) \right) \f}
+         * @details 共分散行列を1回だけ Cholesky 分解して閉じた式で求める (各データの pdf は作らない)。
+         * 高次元で pdf が 0 にアンダーフローしても有限の値になる
+         * @param[in] weight 重みの和 W (重みなしならデータ数)
+         * @param[in] scatter 平均まわりの散布行列 \f$ S = \Sigma w (x - mean)(x - mean)^T \f$
+         * @param[in] covariance 共分散行列 \f$ \Sigma \f$
+         * @return 共分散行列が正定値でなければ (データが部分空間に縮退しているとき) -inf
+         */
+        double calcLogLikelihood(const double weight, const Eigen::MatrixXd &scatter, const Eigen::MatrixXd &covariance)
+        {
+            const double p(covariance.rows());
+            const Eigen::LLT<Eigen::MatrixXd> llt(covariance);
+            if ( llt.info() != Eigen::Success )
+            {
+                return -std::numeric_limits<double>::infinity();
+            }
+
+            // log|Σ| = 2 Σ log(L_ii) //
+            const double log_determinant = 2.0 * llt.matrixLLT().diagonal().array().log().sum();
+            const double mahalanobis = llt.solve(scatter).trace();
+            return -0.5 * (weight * (p * std::log(2.0 * M_PI) + log_determinant) + mahalanobis);
+        }
+
+
         /**
          * @brief 対数尤度 \f$ log(likelihood) \f$
          * \f{eqnarray*}{ likelihood = \Pi pdf \f}
          * \f{eqnarray*}{ log(likelihood) = \Sigma log(pdf) \f}
+         * @details 散布行列から閉じた式で求める
+         * @see calcLogLikelihood(const double, const Eigen::MatrixXd&, const Eigen::MatrixXd&)
          */
         double calcLogLikelihood(const Eigen::MatrixXd &dataset, const Eigen::VectorXd &mean)
         {
             // calc parameter
-            //Eigen::VectorXd mean(dataset.colwise().mean());
             Eigen::MatrixXd covariance;
             calcCovariance(dataset, covariance);
 
             // calc likelihood
-            const std::size_t num(dataset.rows());
-            double log_likelihood(0.0);
-            for (std::size_t i = 0; i < num; ++i)
-            {
-                double pdf = probabilityDensityFunction(dataset.row(i), mean, covariance);
-                log_likelihood += std::log(pdf);
-            }
-            return log_likelihood;
+            const Eigen::MatrixXd centered = dataset.rowwise() - mean.transpose();
+            return calcLogLikelihood(static_cast<double>(dataset.rows()), centered.adjoint() * centered, covariance);
         }
 
     
+        /**
+         * @brief 重み付きデータの対数尤度 \f$ \Sigma w log(pdf) \f$
+         * @param[in] weights 各データの重み
+         * @see calcLogLikelihood
+         */
+        double calcLogLikelihood(const Eigen::MatrixXd &dataset, const Eigen::VectorXd &weights, const Eigen::VectorXd &mean)
+        {
+            // calc parameter
+            Eigen::MatrixXd covariance;
+            calcCovariance(dataset, weights, covariance);
+
+            // calc likelihood
+            const Eigen::MatrixXd centered = dataset.rowwise() - mean.transpose();
+            return calcLogLikelihood(weights.sum(), centered.adjoint() * weights.asDiagonal() * centered, covariance);
+        }
+
+
         /**
          * @brief 対数尤度 \f$ log(likelihood) \f$
          * @see calcLogLikelihood
@@ -0,0 +1,648 @@
+/**
+ * @file benchmark.cpp
+ * @brief KMeans / FixedKMeans / HierarchicalKMeans / XMeans / GaussianMixtureModel / KdTree のベンチマーク
+ * @details ガウス分布の塊 (N, D, k を指定) か test/ (*) /log 形式のテキストファイルを入力にして、
+ * 1ケースごとに子プロセスで計測する (ピークメモリをケースごとに取るため)。 @n
+ * 結果は CSV か JSON で出力する
+ *
+ * usage : ./benchmark [options]
+ *   --algo kmeans,xmeans,gmm,kdtree  計測するアルゴリズム (fixed_kmeans は D = 2, 3, 4 のみ)
+ *                                    xmeans_ishioka, xmeans_mndl, xmeans_gmeans は分割の評価方法だけ xmeans と違う
+ *                                    hierarchical_kmeans は深さ3の木 (k は各ノードの分割数)
+ *   --n 10000,100000                 データ数 (生成データ)
+ *   --d 2,16                         次元数 (生成データ)
+ *   --k 8,64                         クラスタ数 (xmeans は初期クラスタ数、hierarchical_kmeans は分割数、kdtree は近傍数)
+ *   --queries Q                      kdtree の探索回数 (データから等間隔に選ぶ)
+ *   --file path[,path...]            生成データの代わりにファイルを読む (1行に1点 or 複数点)
+ *   --dim D                          ファイルの次元数 (省略時は1行目の要素数)
+ *   --repeat R                       各ケースの繰り返し回数 (シードは seed + 繰り返し番号)
+ *   --seed S                         乱数のシード
+ *   --format csv|json                出力形式
+ *   --output path                    出力先 (省略時は標準出力)
+ *
+ * 例 : x-means の分割の評価方法の比較 (test/xmeans/log のデータ) @n
+ *   ./benchmark --algo xmeans,xmeans_ishioka,xmeans_mndl,xmeans_gmeans --file ../xmeans/log/sample_dataset_02.log --k 2 --repeat 3
+ */
+
+#include <scl/clustering/KMeans.hpp>
+#include <scl/clustering/FixedKMeans.hpp>
+#include <scl/clustering/HierarchicalKMeans.hpp>
+#include <scl/clustering/XMeans.hpp>
+#include <scl/clustering/GaussianMixtureModel.hpp>
+#include <scl/tree/KdTree.hpp>
+#include <scl/util/EigenUtil.hpp>
+
+#include <sys/resource.h>  // getrusage, wait4
+#include <sys/wait.h>
+#include <unistd.h>        // fork, pipe
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <limits>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+
+/**
+ * @brief ベンチマークの1ケース
+ */
+struct Case
+{
+    std::string algorithm;  /**< kmeans, fixed_kmeans, hierarchical_kmeans, xmeans, xmeans_ishioka, xmeans_mndl, xmeans_gmeans, gmm, kdtree */
+    std::string source;     /**< "synthetic" or ファイル名 */
+    std::size_t num_data;
+    std::size_t dim;
+    std::size_t k;
+    std::size_t repeat;
+    std::uint64_t seed;
+    std::size_t num_queries;  /**< kdtree の探索回数 */
+};
+
+
+/**
+ * @brief 1ケースの計測結果 (子プロセスから pipe で返すので POD)
+ */
+struct Measurement
+{
+    int is_valid;
+    double seconds;            /**< 全体の時間 */
+    double build_seconds;      /**< 木の構築時間 (kdtree のみ) */
+    double query_seconds;      /**< 探索時間 (kdtree のみ) */
+    double num_iterations;     /**< 反復回数 (ないものは NaN) */
+    double seconds_per_iter;   /**< 1反復の時間 (ないものは NaN) */
+    double points_per_second;  /**< データ数 (x 反復回数) / 時間 (kdtree は探索回数 / 探索時間) */
+    double peak_rss_kb;        /**< 子プロセスのピークメモリ */
+    double inertia;            /**< 所属クラスタの平均との距離の2乗の総和 (kdtree は最近傍距離の平均) */
+    double bic;                /**< BIC (GMM のみ) */
+    double num_clusters;       /**< 得られたクラスタ数 */
+};
+
+
+/**
+ * @brief カンマ区切りの分割
+ */
+std::vector<std::string> split(const std::string &text)
+{
+    std::vector<std::string> tokens;
+    std::stringstream ss(text);
+    std::string token;
+    while ( std::getline(ss, token, ',') )
+    {
+        if ( !token.empty() )
+        {
+            tokens.push_back(token);
+        }
+    }
+    return tokens;
+}
+
+
+std::vector<std::size_t> splitSizes(const std::string &text)
+{
+    std::vector<std::size_t> values;
+    std::vector<std::string> tokens( split(text) );
+    for (std::size_t i = 0; i < tokens.size(); ++i)
+    {
+        values.push_back( std::stoul(tokens[i]) );
+    }
+    return values;
+}
+
+
+/**
+ * @brief ガウス分布の塊を生成
+ * @details 中心は [-10, 10]^D の一様乱数、標準偏差は 1
+ */
+void generateBlobs(const std::size_t num_data, const std::size_t dim, const std::size_t num_blobs, const std::uint64_t seed,
+                   std::vector< std::vector<double> > &dataset)
+{
+    std::mt19937 engine( scl::rng::makeEngine(seed) );
+    std::uniform_real_distribution<double> center_distribution(-10.0, 10.0);
+    std::normal_distribution<double> noise(0.0, 1.0);
+
+    std::vector< std::vector<double> > centers(std::max<std::size_t>(num_blobs, 1), std::vector<double>(dim));
+    for (std::size_t blob_index = 0; blob_index < centers.size(); ++blob_index)
+    {
+        for (std::size_t d = 0; d < dim; ++d)
+        {
+            centers[blob_index][d] = center_distribution(engine);
+        }
+    }
+
+    dataset.assign(num_data, std::vector<double>(dim));
+    for (std::size_t data_index = 0; data_index < num_data; ++data_index)
+    {
+        const std::vector<double> &center( centers[data_index % centers.size()] );
+        for (std::size_t d = 0; d < dim; ++d)
+        {
+            dataset[data_index][d] = center[d] + noise(engine);
+        }
+    }
+}
+
+
+/**
+ * @brief test/ (*) /log 形式のファイルを読む
+ * @details 空白区切りの数値を dim 個ずつに分けて1点とする (1行に1点でも、1行に1クラスタ分並んでいてもよい)
+ * @param[in,out] dim 次元数 (0 なら1行目の要素数にする)
+ */
+bool loadDataset(const std::string &file_name, std::size_t &dim, std::vector< std::vector<double> > &dataset)
+{
+    std::ifstream file(file_name);
+    if ( !file )
+    {
+        return false;
+    }
+
+    std::vector<double> values;
+    std::string line;
+    while ( std::getline(file, line) )
+    {
+        std::stringstream ss(line);
+        std::size_t num_values(0);
+        double value(0);
+        while ( ss >> value )
+        {
+            values.push_back(value);
+            ++num_values;
+        }
+        if (dim == 0 && num_values > 0)
+        {
+            dim = num_values;
+        }
+    }
+    if (dim == 0)
+    {
+        return false;
+    }
+
+    dataset.clear();
+    for (std::size_t begin = 0; begin + dim <= values.size(); begin += dim)
+    {
+        dataset.push_back( std::vector<double>(values.begin() + begin, values.begin() + begin + dim) );
+    }
+    return !dataset.empty();
+}
+
+
+/**
+ * @brief ラベルから各クラスタの平均を計算して、平均との距離の2乗の総和
+ */
+double calcInertia(const std::vector< std::vector<double> > &dataset, const std::vector<std::uint32_t> &labels, const std::size_t num_clusters)
+{
+    const std::size_t dim( dataset.front().size() );
+    std::vector< std::vector<double> > means(num_clusters, std::vector<double>(dim, 0.0));
+    std::vector<double> counts(num_clusters, 0.0);
+    for (std::size_t data_index = 0; data_index < labels.size(); ++data_index)
+    {
+        for (std::size_t d = 0; d < dim; ++d)
+        {
+            means[labels[data_index]][d] += dataset[data_index][d];
+        }
+        counts[labels[data_index]] += 1.0;
+    }
+    for (std::size_t cluster_index = 0; cluster_index < num_clusters; ++cluster_index)
+    {
+        for (std::size_t d = 0; d < dim && counts[cluster_index] > 0.0; ++d)
+        {
+            means[cluster_index][d] /= counts[cluster_index];
+        }
+    }
+
+    double inertia(0.0);
+    for (std::size_t data_index = 0; data_index < labels.size(); ++data_index)
+    {
+        for (std::size_t d = 0; d < dim; ++d)
+        {
+            double diff = dataset[data_index][d] - means[labels[data_index]][d];
+            inertia += diff * diff;
+        }
+    }
+    return inertia;
+}
+
+
+/**
+ * @brief FixedKMeans の計測
+ */
+template<std::size_t Dim>
+void measureFixedKMeans(const Case &bench_case, const std::vector< std::vector<double> > &dataset, Measurement &result)
+{
+    std::chrono::steady_clock::time_point start( std::chrono::steady_clock::now() );
+    scl::FixedKMeans<Dim> kmeans;
+    kmeans.setSeed(bench_case.seed);
+    kmeans.setParameters(100, 1e-4);
+    std::vector< std::vector<double> > centroids;
+    kmeans.clustering(Dim, dataset, bench_case.k, centroids);
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    result.num_iterations = static_cast<double>(kmeans.getResult().num_iterations);
+    result.inertia = kmeans.getResult().inertia;
+    result.num_clusters = static_cast<double>(centroids.size());
+}
+
+
+/**
+ * @brief 1ケースの計測 (子プロセスで実行)
+ */
+Measurement measure(const Case &bench_case, const std::vector< std::vector<double> > &dataset)
+{
+    const double nan( std::numeric_limits<double>::quiet_NaN() );
+    Measurement result;
+    result.is_valid = 1;
+    result.num_iterations = nan;
+    result.seconds_per_iter = nan;
+    result.build_seconds = nan;
+    result.query_seconds = nan;
+    result.inertia = nan;
+    result.bic = nan;
+    result.num_clusters = nan;
+
+    const std::size_t num_data( dataset.size() );
+    const std::size_t dim( bench_case.dim );
+    std::chrono::steady_clock::time_point start( std::chrono::steady_clock::now() );
+
+    if (bench_case.algorithm == "kmeans")
+    {
+        scl::KMeans kmeans;
+        kmeans.setSeed(bench_case.seed);
+        kmeans.setParameters(100, 1e-4);
+        std::vector< std::vector<double> > centroids;
+        kmeans.clustering(dim, dataset, bench_case.k, centroids);
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        result.num_iterations = static_cast<double>(kmeans.getResult().num_iterations);
+        result.inertia = kmeans.getResult().inertia;
+        result.num_clusters = static_cast<double>(centroids.size());
+    }
+    else if (bench_case.algorithm == "fixed_kmeans" && dim >= 2 && dim <= 4)
+    {
+        switch (dim)
+        {
+        case 2: measureFixedKMeans<2>(bench_case, dataset, result); break;
+        case 3: measureFixedKMeans<3>(bench_case, dataset, result); break;
+        default: measureFixedKMeans<4>(bench_case, dataset, result); break;
+        }
+    }
+    else if (bench_case.algorithm == "hierarchical_kmeans")
+    {
+        scl::HierarchicalKMeans hkm;
+        hkm.setSeed(bench_case.seed);
+        hkm.setParameters(bench_case.k, 3);
+        hkm.setKMeansParameters(100, 1e-4);
+        hkm.clustering(dim, dataset);
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::vector<std::uint32_t> labels(num_data, 0);
+        for (std::size_t cluster_id = 0; cluster_id < hkm.getNumLeaves(); ++cluster_id)
+        {
+            const std::vector<std::size_t> &cluster( hkm.getCluster(cluster_id) );
+            for (std::size_t member_index = 0; member_index < cluster.size(); ++member_index)
+            {
+                labels[cluster[member_index]] = static_cast<std::uint32_t>(cluster_id);
+            }
+        }
+        result.inertia = calcInertia(dataset, labels, hkm.getNumLeaves());
+        result.num_clusters = static_cast<double>(hkm.getNumLeaves());
+    }
+    else if (bench_case.algorithm == "xmeans" || bench_case.algorithm == "xmeans_ishioka" || bench_case.algorithm == "xmeans_mndl"
+             || bench_case.algorithm == "xmeans_gmeans")
+    {
+        scl::XMeans xmeans;
+        xmeans.setSeed(bench_case.seed);
+        if (bench_case.algorithm == "xmeans_ishioka")
+        {
+            xmeans.setSplittingType(scl::XMeans::BIC_ISHIOKA);
+        }
+        else if (bench_case.algorithm == "xmeans_mndl")
+        {
+            xmeans.setSplittingType(scl::XMeans::MNDL);
+        }
+        else if (bench_case.algorithm == "xmeans_gmeans")
+        {
+            xmeans.setSplittingType(scl::XMeans::ANDERSON_DARLING);
+        }
+        std::vector< std::vector<double> > centroids;
+        xmeans.clustering(dim, dataset, bench_case.k, centroids);
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        result.inertia = calcInertia(dataset, xmeans.getLabels(), centroids.size());
+        result.num_clusters = static_cast<double>(centroids.size());
+    }
+    else if (bench_case.algorithm == "gmm")
+    {
+        scl::GaussianMixtureModel gmm;
+        gmm.setSeed(bench_case.seed);
+        std::vector< std::vector<double> > centroids;
+        gmm.clustering(dim, dataset, bench_case.k, centroids);
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        result.inertia = calcInertia(dataset, gmm.getLabels(), bench_case.k);
+        result.bic = gmm.calcBIC( scl::toEigenMatrix(dim, dataset) );
+        result.num_clusters = static_cast<double>(bench_case.k);
+    }
+    else if (bench_case.algorithm == "kdtree")
+    {
+        // 全データを木に入れて、等間隔に選んだデータの k 近傍を探索 (構築と探索は別に計る) //
+        scl::KdTree< std::vector<double> > tree(dataset);
+        const std::chrono::steady_clock::time_point built( std::chrono::steady_clock::now() );
+        const std::size_t num_queries( std::max<std::size_t>(std::min(bench_case.num_queries, num_data), 1) );
+        std::vector<std::size_t> indices;
+        std::vector<double> distances;
+        double sum_distance(0.0);
+        for (std::size_t query_index = 0; query_index < num_queries; ++query_index)
+        {
+            tree.knnSearch(dataset[query_index * num_data / num_queries], bench_case.k, indices, distances);
+            if ( !distances.empty() )
+            {
+                sum_distance += distances.back();
+            }
+        }
+        const std::chrono::steady_clock::time_point end( std::chrono::steady_clock::now() );
+        result.seconds = std::chrono::duration<double>(end - start).count();
+        result.build_seconds = std::chrono::duration<double>(built - start).count();
+        result.query_seconds = std::chrono::duration<double>(end - built).count();
+
+        result.num_iterations = static_cast<double>(num_queries);
+        result.inertia = sum_distance / static_cast<double>(num_queries);  // k 番目の近傍までの平均距離 //
+    }
+    else
+    {
+        result.is_valid = 0;
+        result.seconds = nan;
+    }
+
+    // 反復のあるものは データ数 x 反復回数 / 時間 (kdtree は1探索を1反復として、探索時間だけで割る) //
+    if (bench_case.algorithm == "kdtree")
+    {
+        result.seconds_per_iter = result.query_seconds / result.num_iterations;
+        result.points_per_second = result.num_iterations / result.query_seconds;
+    }
+    else
+    {
+        if ( !std::isnan(result.num_iterations) && result.num_iterations > 0.0 )
+        {
+            result.seconds_per_iter = result.seconds / result.num_iterations;
+        }
+        const double num_passes = std::isnan(result.num_iterations) ? 1.0 : result.num_iterations;
+        result.points_per_second = static_cast<double>(num_data) * num_passes / result.seconds;
+    }
+    return result;
+}
+
+
+/**
+ * @brief 子プロセスで計測して結果とピークメモリを受け取る
+ */
+Measurement runCase(const Case &bench_case, const std::vector< std::vector<double> > &dataset)
+{
+    Measurement result;
+    std::memset(&result, 0, sizeof(result));
+
+    int fds[2];
+    if (pipe(fds) != 0)
+    {
+        return result;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        close(fds[0]);
+        close(fds[1]);
+        return result;
+    }
+    if (pid == 0)
+    {
+        // child : ライブラリのデバッグ出力が結果に混ざらないようにする //
+        close(fds[0]);
+        if ( std::freopen("/dev/null", "w", stdout) == NULL )
+        {
+            _exit(1);
+        }
+        Measurement child_result( measure(bench_case, dataset) );
+        ssize_t written = write(fds[1], &child_result, sizeof(child_result));
+        close(fds[1]);
+        _exit(written == static_cast<ssize_t>(sizeof(child_result)) ? 0 : 1);
+    }
+
+    // parent
+    close(fds[1]);
+    ssize_t received = read(fds[0], &result, sizeof(result));
+    close(fds[0]);
+
+    int status(0);
+    struct rusage usage;
+    std::memset(&usage, 0, sizeof(usage));
+    wait4(pid, &status, 0, &usage);
+    if (received != static_cast<ssize_t>(sizeof(result)) || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        result.is_valid = 0;
+    }
+    result.peak_rss_kb = static_cast<double>(usage.ru_maxrss);  // Linux では KB //
+    return result;
+}
+
+
+/**
+ * @brief 数値の出力 (NaN は空欄 / null)
+ */
+std::string formatValue(const double value, const bool is_json)
+{
+    if ( std::isnan(value) || std::isinf(value) )
+    {
+        return is_json ? "null" : "";
+    }
+    std::ostringstream ss;
+    ss.precision(10);
+    ss << value;
+    return ss.str();
+}
+
+
+void writeHeader(std::ostream &os, const bool is_json)
+{
+    if (is_json)
+    {
+        os << "[" << std::endl;
+    }
+    else
+    {
+        os << "algorithm,source,n,d,k,repeat,seed,valid,seconds,build_seconds,query_seconds,iterations,seconds_per_iter,points_per_second,peak_rss_kb,inertia,bic,clusters" << std::endl;
+    }
+}
+
+
+void writeRecord(std::ostream &os, const Case &bench_case, const Measurement &result, const bool is_json, const bool is_first)
+{
+    if (is_json)
+    {
+        os << (is_first ? "  {" : ",\n  {")
+           << "\"algorithm\": \"" << bench_case.algorithm << "\", "
+           << "\"source\": \"" << bench_case.source << "\", "
+           << "\"n\": " << bench_case.num_data << ", "
+           << "\"d\": " << bench_case.dim << ", "
+           << "\"k\": " << bench_case.k << ", "
+           << "\"repeat\": " << bench_case.repeat << ", "
+           << "\"seed\": " << bench_case.seed << ", "
+           << "\"valid\": " << (result.is_valid ? "true" : "false") << ", "
+           << "\"seconds\": " << formatValue(result.seconds, true) << ", "
+           << "\"build_seconds\": " << formatValue(result.build_seconds, true) << ", "
+           << "\"query_seconds\": " << formatValue(result.query_seconds, true) << ", "
+           << "\"iterations\": " << formatValue(result.num_iterations, true) << ", "
+           << "\"seconds_per_iter\": " << formatValue(result.seconds_per_iter, true) << ", "
+           << "\"points_per_second\": " << formatValue(result.points_per_second, true) << ", "
+           << "\"peak_rss_kb\": " << formatValue(result.peak_rss_kb, true) << ", "
+           << "\"inertia\": " << formatValue(result.inertia, true) << ", "
+           << "\"bic\": " << formatValue(result.bic, true) << ", "
+           << "\"clusters\": " << formatValue(result.num_clusters, true) << "}";
+    }
+    else
+    {
+        os << bench_case.algorithm << "," << bench_case.source << ","
+           << bench_case.num_data << "," << bench_case.dim << "," << bench_case.k << ","
+           << bench_case.repeat << "," << bench_case.seed << "," << result.is_valid << ","
+           << formatValue(result.seconds, false) << ","
+           << formatValue(result.build_seconds, false) << ","
+           << formatValue(result.query_seconds, false) << ","
+           << formatValue(result.num_iterations, false) << ","
+           << formatValue(result.seconds_per_iter, false) << ","
+           << formatValue(result.points_per_second, false) << ","
+           << formatValue(result.peak_rss_kb, false) << ","
+           << formatValue(result.inertia, false) << ","
+           << formatValue(result.bic, false) << ","
+           << formatValue(result.num_clusters, false) << std::endl;
+    }
+    os.flush();
+}
+
+
+void writeFooter(std::ostream &os, const bool is_json)
+{
+    if (is_json)
+    {
+        os << "\n]" << std::endl;
+    }
+}
+
+
+int main (int argc, char **argv)
+{
+    // default parameters
+    std::vector<std::string> algorithms( split("kmeans,xmeans,gmm,kdtree") );
+    std::vector<std::size_t> num_data_list( splitSizes("2000,20000") );
+    std::vector<std::size_t> dim_list( splitSizes("2,16") );
+    std::vector<std::size_t> k_list( splitSizes("8") );
+    std::vector<std::string> files;
+    std::size_t file_dim(0), num_repeats(1), num_queries(200);
+    std::uint64_t seed(0);
+    std::string format("csv"), output;
+
+    // parse options
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const std::string option(argv[i]), value(argv[i + 1]);
+        if (option == "--algo")         { algorithms = split(value); }
+        else if (option == "--n")       { num_data_list = splitSizes(value); }
+        else if (option == "--d")       { dim_list = splitSizes(value); }
+        else if (option == "--k")       { k_list = splitSizes(value); }
+        else if (option == "--file")    { files = split(value); }
+        else if (option == "--dim")     { file_dim = std::stoul(value); }
+        else if (option == "--repeat")  { num_repeats = std::max<std::size_t>(std::stoul(value), 1); }
+        else if (option == "--queries") { num_queries = std::stoul(value); }
+        else if (option == "--seed")    { seed = std::stoull(value); }
+        else if (option == "--format")  { format = value; }
+        else if (option == "--output")  { output = value; }
+        else
+        {
+            std::cerr << "unknown option : " << option << std::endl;
+            return 1;
+        }
+    }
+    const bool is_json(format == "json");
+
+    std::ofstream file_stream;
+    if ( !output.empty() )
+    {
+        file_stream.open(output);
+        if ( !file_stream )
+        {
+            std::cerr << "cannot open : " << output << std::endl;
+            return 1;
+        }
+    }
+    std::ostream &os = output.empty() ? std::cout : file_stream;
+
+
+    // run
+    bool is_first(true);
+    writeHeader(os, is_json);
+    std::vector< std::vector<double> > dataset;
+
+    // 生成データは (N, D, k) ごと、ファイルはファイルごとに作って全アルゴリズムで使う //
+    std::vector<Case> sources;
+    if ( files.empty() )
+    {
+        for (std::size_t n_index = 0; n_index < num_data_list.size(); ++n_index)
+        {
+            for (std::size_t d_index = 0; d_index < dim_list.size(); ++d_index)
+            {
+                for (std::size_t k_index = 0; k_index < k_list.size(); ++k_index)
+                {
+                    Case source = {"", "synthetic", num_data_list[n_index], dim_list[d_index], k_list[k_index], 0, 0, num_queries};
+                    sources.push_back(source);
+                }
+            }
+        }
+    }
+    else
+    {
+        for (std::size_t file_index = 0; file_index < files.size(); ++file_index)
+        {
+            for (std::size_t k_index = 0; k_index < k_list.size(); ++k_index)
+            {
+                Case source = {"", files[file_index], 0, file_dim, k_list[k_index], 0, 0, num_queries};
+                sources.push_back(source);
+            }
+        }
+    }
+
+    for (std::size_t source_index = 0; source_index < sources.size(); ++source_index)
+    {
+        for (std::size_t repeat = 0; repeat < num_repeats; ++repeat)
+        {
+            Case bench_case( sources[source_index] );
+            bench_case.repeat = repeat;
+            bench_case.seed = seed + repeat;
+
+            if (bench_case.source == "synthetic")
+            {
+                generateBlobs(bench_case.num_data, bench_case.dim, bench_case.k, bench_case.seed, dataset);
+            }
+            else if ( !loadDataset(bench_case.source, bench_case.dim, dataset) )
+            {
+                std::cerr << "cannot load : " << bench_case.source << std::endl;
+                continue;
+            }
+            bench_case.num_data = dataset.size();
+
+            for (std::size_t algorithm_index = 0; algorithm_index < algorithms.size(); ++algorithm_index)
+            {
+                bench_case.algorithm = algorithms[algorithm_index];
+                Measurement result( runCase(bench_case, dataset) );
+                writeRecord(os, bench_case, result, is_json, is_first);
+                is_first = false;
+            }
+        }
+    }
+    writeFooter(os, is_json);
+
+    return 0;
+}
@@ -0,0 +1,33 @@
+#ifndef KMEANS_TEST_CALC_COST_HPP
+#define KMEANS_TEST_CALC_COST_HPP
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+
+/**
+ * @brief 全データに対するコスト (最近傍 centroid までの二乗距離の和)
+ */
+inline double calcCost(const std::vector< std::vector<double> > &dataset, const std::vector< std::vector<double> > &centroids)
+{
+    double cost(0.0);
+    for (std::size_t data_index = 0; data_index < dataset.size(); ++data_index)
+    {
+        double min_distance(std::numeric_limits<double>::max());
+        for (std::size_t cluster_index = 0; cluster_index < centroids.size(); ++cluster_index)
+        {
+            double distance(0.0);
+            for (std::size_t value_index = 0; value_index < dataset[data_index].size(); ++value_index)
+            {
+                const double error = dataset[data_index][value_index] - centroids[cluster_index][value_index];
+                distance += error * error;
+            }
+            min_distance = std::min(min_distance, distance);
+        }
+        cost += min_distance;
+    }
+    return cost;
+}
+
+#endif  /* KMEANS_TEST_CALC_COST_HPP */
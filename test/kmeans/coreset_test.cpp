@@ -0,0 +1,110 @@
+#include <scl/clustering/Coreset.hpp>
+#include <scl/clustering/XMeans.hpp>
+#include "calc_cost.hpp"
+#include <sstream>
+#include <fstream>
+#include <vector>
+#include <iostream>
+
+
+int main (int argc, char **argv)
+{
+    // file open
+    std::string file_name("./log/sample_data.log");
+    std::ifstream file(file_name);
+    if ( !file )
+    {
+        return 0;
+    }
+
+
+    // load data
+    std::vector< std::vector<double> > dataset;
+    std::string line;
+    while ( std::getline(file, line) )
+    {
+        if ( line.size() > 1 )
+        {
+            std::stringstream ss(line);
+            std::vector<double> data;
+            double tmp(0);
+            while ( !ss.eof() )
+            {
+                ss >> tmp;
+                data.push_back(tmp);
+            }
+            dataset.push_back(data);
+        }
+    }
+    file.close();
+
+
+    //
+    // k-means on all data
+    //
+    scl::KMeans kmeans;
+    kmeans.setSeed(0);
+    std::vector< std::vector<double> > centroids;
+    kmeans.clustering(2, dataset, 6, centroids);
+    const double full_cost(calcCost(dataset, centroids));
+    std::cout << "all data : " << dataset.size() << " points, cost " << full_cost << std::endl;
+
+    // コアセット上の結果は全データに対するコストで比べる //
+    const double max_ratio(1.3);
+    bool is_success(true);
+
+
+    //
+    // k-means / x-means on the coreset
+    //
+    const char *method_names[] = {"lightweight", "sensitivity"};
+    for (int method = scl::Coreset::LIGHTWEIGHT; method <= scl::Coreset::SENSITIVITY; ++method)
+    {
+        scl::Coreset coreset;
+        coreset.setParameters(30, static_cast<scl::Coreset::Method>(method), 6);
+        coreset.setSeed(0);
+        coreset.build(2, dataset);
+
+        kmeans.clustering(2, coreset.getPoints(), coreset.getWeights(), 6, centroids);
+        const double coreset_cost(calcCost(dataset, centroids));
+        std::cout << method_names[method] << " : " << coreset.getPoints().size() << " points, cost " << coreset_cost << std::endl;
+
+        // コアセットは各塊の点が少ないので、コアセットを作った k から分割を始める //
+        scl::XMeans xmeans;
+        xmeans.setSeed(0);
+        xmeans.clustering(2, coreset.getPoints(), coreset.getWeights(), 6, centroids);
+        const double xmeans_cost(calcCost(dataset, centroids));
+        std::cout << "  x-means : " << centroids.size() << " clusters, cost " << xmeans_cost << std::endl;
+
+        if (coreset_cost > max_ratio * full_cost || xmeans_cost > max_ratio * full_cost)
+        {
+            is_success = false;
+        }
+    }
+
+
+    //
+    // merge and reduce
+    //
+    const std::size_t batch_size(15);
+    scl::Coreset stream;
+    stream.setParameters(30);
+    stream.setSeed(0);
+    for (std::size_t begin = 0; begin < dataset.size(); begin += batch_size)
+    {
+        std::vector< std::vector<double> > batch(dataset.begin() + begin, dataset.begin() + std::min(begin + batch_size, dataset.size()));
+        stream.add(2, batch);
+    }
+    kmeans.clustering(2, stream.getPoints(), stream.getWeights(), 6, centroids);
+    const double stream_cost(calcCost(dataset, centroids));
+    std::cout << "stream : " << stream.getPoints().size() << " points, cost " << stream_cost << std::endl;
+
+    if ( !is_success || stream_cost > max_ratio * full_cost)
+    {
+        std::cout << "failure" << std::endl;
+        return 1;
+    }
+    std::cout << "success" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,118 @@
+#include <scl/clustering/HierarchicalKMeans.hpp>
+#include <sstream>
+#include <fstream>
+#include <vector>
+#include <iostream>
+#include <random>
+
+
+/** @brief 各データは1つの葉にだけ入り、 predict はその葉を返すか */
+bool checkLeaves(const scl::HierarchicalKMeans &hkm, const std::vector< std::vector<double> > &dataset)
+{
+    std::vector<std::size_t> assigned_leaves(dataset.size(), hkm.getNumLeaves());
+    for (std::size_t cluster_id = 0; cluster_id < hkm.getNumLeaves(); ++cluster_id)
+    {
+        const std::vector<std::size_t> &cluster(hkm.getCluster(cluster_id));
+        for (std::size_t member_index = 0; member_index < cluster.size(); ++member_index)
+        {
+            if (assigned_leaves[cluster[member_index]] != hkm.getNumLeaves())
+            {
+                std::cout << "failure : data " << cluster[member_index] << " is in two leaves" << std::endl;
+                return false;
+            }
+            assigned_leaves[cluster[member_index]] = cluster_id;
+        }
+    }
+
+    for (std::size_t data_index = 0; data_index < dataset.size(); ++data_index)
+    {
+        const std::size_t leaf_id(hkm.predict(dataset[data_index]));
+        if (leaf_id != assigned_leaves[data_index])
+        {
+            std::cout << "failure : data " << data_index << " is predicted " << leaf_id << " but assigned " << assigned_leaves[data_index] << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+
+int main (int argc, char **argv)
+{
+    // file open
+    std::string file_name("./log/sample_data.log");
+    std::ifstream file(file_name);
+    if ( !file )
+    {
+        return 0;
+    }
+
+
+    // load data
+    std::vector< std::vector<double> > dataset;
+    std::string line;
+    while ( std::getline(file, line) )
+    {
+        if ( line.size() > 1 )
+        {
+            std::stringstream ss(line);
+            std::vector<double> data;
+            double tmp(0);
+            while ( !ss.eof() )
+            {
+                ss >> tmp;
+                data.push_back(tmp);
+            }
+            dataset.push_back(data);
+        }
+    }
+    file.close();
+
+
+    //
+    // hierarchical k-means
+    //
+    scl::HierarchicalKMeans hkm;
+    hkm.setParameters(3, 3);
+    hkm.setSeed(0);
+    hkm.clustering(2, dataset);
+
+    std::cout << "nodes : " << hkm.getNodes().size() << ", leaves : " << hkm.getNumLeaves() << std::endl;
+    for (std::size_t cluster_id = 0; cluster_id < hkm.getNumLeaves(); ++cluster_id)
+    {
+        std::cout << "  " << hkm.getCluster(cluster_id).size();
+    }
+    std::cout << std::endl;
+
+
+    if ( !checkLeaves(hkm, dataset) )
+    {
+        return 1;
+    }
+
+
+    //
+    // 塊のない一様乱数のデータ (各ノードの k-means が収束前に打ち切られる)
+    //
+    std::mt19937 engine(0);
+    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+    std::vector< std::vector<double> > uniform_dataset(2000, std::vector<double>(2, 0.0));
+    for (std::size_t data_index = 0; data_index < uniform_dataset.size(); ++data_index)
+    {
+        uniform_dataset[data_index][0] = distribution(engine);
+        uniform_dataset[data_index][1] = distribution(engine);
+    }
+
+    scl::HierarchicalKMeans uniform_hkm;
+    uniform_hkm.setParameters(4, 3);
+    uniform_hkm.setSeed(0);
+    uniform_hkm.clustering(2, uniform_dataset);
+    std::cout << "uniform : leaves " << uniform_hkm.getNumLeaves() << std::endl;
+    if ( !checkLeaves(uniform_hkm, uniform_dataset) )
+    {
+        return 1;
+    }
+    std::cout << "success" << std::endl;
+
+    return 0;
+}
@@ -82,6 +82,7 @@ int main ()
     std::vector< std::vector<std::size_t> > clusters_random(cluster_size);
     std::vector< std::vector<std::size_t> > clusters_uniform(cluster_size);
     std::vector< std::vector<std::size_t> > clusters_pp(cluster_size);
+    std::vector< std::vector<std::size_t> > clusters_scalable(cluster_size);
     std::vector< std::vector<std::size_t> > clusters_manual(cluster_size);
     std::vector< std::vector<std::size_t> > clusters_cv(cluster_size);
     
@@ -102,6 +103,9 @@ int main ()
         kmeans.clustering(2, points, cluster_size, centroids, scl::KMeans::InitMethod::PLUSPLUS);
         clusters_pp = kmeans.getClusters();
 
+        kmeans.clustering(2, points, cluster_size, centroids, scl::KMeans::InitMethod::SCALABLE);
+        clusters_scalable = kmeans.getClusters();
+
         kmeans.clustering(2, points, cluster_size, centroids, scl::KMeans::InitMethod::MANUAL);
         clusters_manual = kmeans.getClusters();
     }
@@ -147,6 +151,7 @@ int main ()
                       << "\t" << clusters_random.at(cluster_id).size()
                       << "\t" << clusters_uniform.at(cluster_id).size()
                       << "\t" << clusters_pp.at(cluster_id).size()
+                      << "\t" << clusters_scalable.at(cluster_id).size()
                       << "\t" << clusters_manual.at(cluster_id).size()
                       << "\t" << clusters_cv.at(cluster_id).size()
                       << std::endl;
@@ -155,6 +160,7 @@ int main ()
         saveClusters("./log/random.log", 2, points, clusters_random);
         saveClusters("./log/uniform.log", 2, points, clusters_uniform);
         saveClusters("./log/data/pp.log", 2, points, clusters_pp);
+        saveClusters("./log/data/scalable.log", 2, points, clusters_scalable);
         saveClusters("./log/data/manual.log", 2, points, clusters_manual);
         saveClusters("./log/data/cv.log", 2, points, clusters_cv);
     }
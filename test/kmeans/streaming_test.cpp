@@ -0,0 +1,119 @@
+#include <scl/clustering/StreamingKMeans.hpp>
+#include "calc_cost.hpp"
+#include <sstream>
+#include <fstream>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <random>
+
+
+int main (int argc, char **argv)
+{
+    // file open
+    std::string file_name("./log/sample_data.log");
+    std::ifstream file(file_name);
+    if ( !file )
+    {
+        return 0;
+    }
+
+
+    // load data
+    std::vector< std::vector<double> > dataset;
+    std::string line;
+    while ( std::getline(file, line) )
+    {
+        if ( line.size() > 1 )
+        {
+            std::stringstream ss(line);
+            std::vector<double> data;
+            double tmp(0);
+            while ( !ss.eof() )
+            {
+                ss >> tmp;
+                data.push_back(tmp);
+            }
+            dataset.push_back(data);
+        }
+    }
+    file.close();
+
+
+    //
+    // k-means on all data (基準)
+    //
+    scl::KMeans kmeans;
+    kmeans.setSeed(0);
+    std::vector< std::vector<double> > centroids;
+    kmeans.clustering(2, dataset, 6, centroids);
+    const double batch_cost(calcCost(dataset, centroids));
+    std::cout << "k-means : cost " << batch_cost << std::endl;
+
+
+    //
+    // streaming (データ順に偏りがないようにシャッフルしたバッチ)
+    //
+    std::vector< std::vector<double> > shuffled(dataset);
+    std::mt19937 engine(0);
+    std::shuffle(shuffled.begin(), shuffled.end(), engine);
+
+    // 最初のバッチで初期化するので、最初のバッチに全ての塊が入る大きさにする //
+    const std::size_t batch_size(30);
+    scl::StreamingKMeans skm;
+    skm.setParameters(6, 0.9);
+    skm.setSeed(0);
+    for (std::size_t begin = 0; begin < shuffled.size(); begin += batch_size)
+    {
+        std::vector< std::vector<double> > batch(shuffled.begin() + begin, shuffled.begin() + std::min(begin + batch_size, shuffled.size()));
+        if ( !skm.partialFit(2, batch) )
+        {
+            std::cout << "failure : partialFit" << std::endl;
+            return 1;
+        }
+    }
+    const double streaming_cost(calcCost(dataset, skm.getCentroids()));
+    std::cout << "streaming : cost " << streaming_cost << std::endl;
+
+
+    //
+    // restart from the previous model
+    //
+    scl::StreamingKMeans restarted;
+    restarted.setCentroids(skm.getCentroids(), skm.getCounts());
+    restarted.partialFit(2, shuffled);
+    const double restarted_cost(calcCost(dataset, restarted.getCentroids()));
+
+    std::vector<std::size_t> sizes(restarted.getCentroids().size(), 0);
+    for (std::size_t data_index = 0; data_index < dataset.size(); ++data_index)
+    {
+        ++sizes[restarted.predict(dataset[data_index])];
+    }
+    std::cout << "restarted : cost " << restarted_cost << std::endl;
+    for (std::size_t cluster_index = 0; cluster_index < sizes.size(); ++cluster_index)
+    {
+        std::cout << "  " << sizes[cluster_index];
+    }
+    std::cout << std::endl;
+
+
+    // 使えない設定 : MANUAL での初期化、次数の違うバッチ //
+    const std::vector< std::vector<double> > wrong_dim_batch(1, std::vector<double>(3, 0.0));
+    if (restarted.setParameters(6, 1.0, scl::KMeans::MANUAL) || restarted.partialFit(3, wrong_dim_batch))
+    {
+        std::cout << "failure : invalid parameters accepted" << std::endl;
+        return 1;
+    }
+
+
+    // 逐次更新なので k-means より少し悪くてよいが、塊を併合するほど悪くはならない //
+    const double max_ratio(1.1);
+    if (streaming_cost > max_ratio * batch_cost || restarted_cost > max_ratio * batch_cost)
+    {
+        std::cout << "failure" << std::endl;
+        return 1;
+    }
+    std::cout << "success" << std::endl;
+
+    return 0;
+}
@@ -80,6 +80,7 @@ int main (int argc, char **argv)
     // x-means
     scl::XMeans xmeans;
     xmeans.setParameters(10, 0.025, 5, scl::KMeans::PLUSPLUS);
+    xmeans.setSeed(0);
     std::vector< std::vector<double> > centroids;
     xmeans.clustering(dim, dataset, 2, centroids);
 
@@ -100,6 +101,44 @@ int main (int argc, char **argv)
     saveClusters("./log/clustering_xmean_cpp.log", dim, dataset, xmeans.getClusters());
 
 
+    // クラスタ数の上限 (初期クラスタ数が上限より多くても上限まで) //
+    const std::size_t max_num_clusters(3);
+    scl::XMeans bounded;
+    bounded.setParameters(10, 0.025, 5, scl::KMeans::PLUSPLUS);
+    bounded.setMaxNumClusters(max_num_clusters);
+    bounded.clustering(dim, dataset, max_num_clusters + 2, centroids);
+    std::cout << "cluster num (max " << max_num_clusters << ") : " << bounded.getClusters().size() << std::endl;
+    if (bounded.getClusters().size() > max_num_clusters)
+    {
+        std::cout << "failure : too many clusters" << std::endl;
+        return 1;
+    }
+
+
+    // incremental x-means (前半でクラスタリングして残りを追加)
+    const std::size_t num_old(num / 2);
+    scl::XMeans incremental;
+    incremental.setParameters(10, 0.025, 5, scl::KMeans::PLUSPLUS);
+    incremental.setSeed(0);
+    incremental.clustering(dim, std::vector< std::vector<double> >(dataset.begin(), dataset.begin() + num_old), 2, centroids);
+    std::cout << "cluster num (first half) : " << incremental.getClusters().size() << std::endl;
+    incremental.update(dim, dataset, num_old, centroids);
+    std::cout << "cluster num (updated) : " << incremental.getClusters().size() << std::endl;
+    for (std::size_t cluster_id = 0; cluster_id < incremental.getClusters().size(); ++cluster_id)
+    {
+        std::cout << "  " << incremental.getCluster(cluster_id).size();
+    }
+    std::cout << std::endl;
+
+    // 追加後は全データを同じシードでクラスタリングした結果と同じクラスタ数になる //
+    if (incremental.getClusters().size() != xmeans.getClusters().size() || incremental.getLabels().size() != num)
+    {
+        std::cout << "failure : incremental update" << std::endl;
+        return 1;
+    }
+    std::cout << "success" << std::endl;
+
+
     // while (!pque.empty()) {
     //     std::cout << "  " << pque.top();
     //     pque.pop();